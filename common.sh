@@ -1 +1 @@
-echo "-DNDEBUG -Wall -flto -lm -Os -s -flto -Iwowlib -DWOW_OVERLOAD_FILE src/*.c -Isrc "
+echo "-DNDEBUG -Wall -flto -lm -pthread -Os -s -flto -Iwowlib -DWOW_OVERLOAD_FILE src/*.c -Isrc "
@@ -2,3 +2,20 @@ mkdir -p bin/release
 
 gcc -o bin/release/z64font-linux -DZ64FONT_GUI `./common.sh` `wowlib/deps/wow_gui_x11.sh`
 
+gcc -o bin/release/z64font-cli-linux `./common.sh`
+
+# the conversion core alone, for programs that convert in-process
+mkdir -p bin/o/linux
+LIBOBJ=
+for src in z64font zchar utf8 ini profile; do
+	gcc -c -fPIC -DNDEBUG -Wall -Os -pthread -Iwowlib -DWOW_OVERLOAD_FILE -Isrc \
+		-o bin/o/linux/$src.o src/$src.c
+	LIBOBJ="$LIBOBJ bin/o/linux/$src.o"
+done
+# wowlib's implementation, which the executables take from cli.c or gui.c;
+# kept in its own object so programs using wowlib themselves link theirs
+echo '#include <wow.h>' | gcc -c -fPIC -DNDEBUG -Wall -Os -Iwowlib \
+	-DWOW_OVERLOAD_FILE -DWOW_IMPLEMENTATION -x c -o bin/o/linux/wow.o -
+LIBOBJ="$LIBOBJ bin/o/linux/wow.o"
+ar rcs bin/release/libz64font.a $LIBOBJ
+gcc -shared -o bin/release/libz64font.so $LIBOBJ -lm -pthread
@@ -11,3 +11,5 @@ i686-w64-mingw32.static-gcc -o bin/release/z64font.exe `./common.sh` \
 	`wowlib/deps/wow_gui_win32.sh` \
 	bin/o/win32/icon.o
 
+i686-w64-mingw32.static-gcc -o bin/release/z64font-cli.exe `./common.sh` \
+	-municode
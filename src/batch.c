@@ -0,0 +1,645 @@
+/* <z64.me> manifest-driven batch conversion */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <wow.h>
+
+#include "z64font.h"
+#include "profile.h"
+#include "ini.h"
+#include "batch.h"
+
+#define  BATCH_PATH_MAX 1024
+
+/* one [section] of the manifest */
+struct batchJob
+{
+	char name[64];
+	char font[BATCH_PATH_MAX];
+	char codepoints[BATCH_PATH_MAX];
+	char names[BATCH_PATH_MAX];   /* decomp png names; "" = none */
+	char targets[BATCH_PATH_MAX]; /* comma-separated profile names */
+	char out[BATCH_PATH_MAX];
+	int fontSize;
+	int yshift;
+	int xPad;
+	int widthAdvance;
+	int oversample;
+	int isSdf;
+	int weight;
+	enum z64font_quantizer quantizer;
+	float gamma;
+	float contrast;
+	int line; /* where the section starts, for error messages */
+	const struct z64font_target *target[BATCH_TARGET_MAX];
+	int targetNum;
+	
+	/* results */
+	int failed;
+	unsigned glyphs;
+	unsigned rasterHits;
+	unsigned rasterMisses;
+	double seconds;
+};
+
+/* loaded once, then shared read-only by every job naming it */
+struct batchFont
+{
+	const char *fn;
+	void *ttfBin;
+	unsigned ttfBinSz;
+	stbtt_fontinfo info;
+};
+
+struct batchCharset
+{
+	const char *fn;
+	char *chars;
+};
+
+/* codepoints mapped to glyphs, once per font and codepoint file pair,
+ * by whichever task needs it first
+ */
+struct batchIndex
+{
+	struct batchFont *font;
+	struct batchCharset *charset;
+	struct zchar *zchar;
+	unsigned zcharNum;
+	int isReady;
+	int failed;
+	pthread_mutex_t lock;
+};
+
+/* jobs that rasterize identically run in sequence on one z64font, so
+ * they reuse its raster cache; tasks are what the pool schedules
+ */
+struct batchTask
+{
+	struct batchIndex *index;
+	struct batchJob **job;
+	int jobNum;
+	size_t cost; /* rough; codepoint bytes times jobs */
+};
+
+/* each worker's share of the tasks */
+struct batchDeque
+{
+	struct batchTask **task;
+	int head; /* the owner takes from here, largest tasks first */
+	int tail; /* thieves take from here */
+	pthread_mutex_t lock;
+};
+
+struct batchRun
+{
+	const char *fn;
+	struct batchJob defaults; /* keys preceding the first section */
+	struct batchJob *job;
+	int jobNum;
+	int jobMax;
+	struct profile_table profiles;
+	struct batchFont *font;
+	int fontNum;
+	struct batchCharset *charset;
+	int charsetNum;
+	struct batchIndex *index;
+	int indexNum;
+	struct batchTask *task;
+	int taskNum;
+	struct batchDeque *deque;
+	int workerNum;
+};
+
+struct batchWorker
+{
+	struct batchRun *run;
+	int self;
+	int steals;
+	pthread_t tid;
+	int isThread;
+};
+
+static void quiet(void *udata, const char *fmt, ...)
+{
+	(void)udata;
+	(void)fmt;
+}
+
+static int onKey(
+	void *udata
+	, const char *section
+	, const char *key
+	, const char *value
+	, int line
+)
+{
+	struct batchRun *run = udata;
+	struct batchJob *job = &run->defaults;
+	char *end = 0;
+	
+	/* keys before the first section apply to every job */
+	if (*section)
+	{
+		job = run->jobNum ? &run->job[run->jobNum - 1] : 0;
+		if (!job || strcmp(job->name, section))
+		{
+			int i;
+			
+			for (i = 0; i < run->jobNum; ++i)
+			{
+				if (!strcmp(run->job[i].name, section))
+				{
+					wow_stderr("%s:%d: job '%s' is defined twice\n", run->fn, line, section);
+					return -1;
+				}
+			}
+			if (run->jobNum == run->jobMax)
+			{
+				run->jobMax = run->jobMax ? run->jobMax * 2 : 16;
+				run->job = wow_realloc_die(run->job, run->jobMax * sizeof(*run->job));
+			}
+			job = &run->job[run->jobNum++];
+			*job = run->defaults;
+			snprintf(job->name, sizeof(job->name), "%s", section);
+			job->line = line;
+		}
+	}
+	
+	if (!strcmp(key, "font"))
+		snprintf(job->font, sizeof(job->font), "%s", value);
+	else if (!strcmp(key, "codepoints"))
+		snprintf(job->codepoints, sizeof(job->codepoints), "%s", value);
+	else if (!strcmp(key, "names"))
+		snprintf(job->names, sizeof(job->names), "%s", value);
+	else if (!strcmp(key, "targets"))
+		snprintf(job->targets, sizeof(job->targets), "%s", value);
+	else if (!strcmp(key, "out"))
+		snprintf(job->out, sizeof(job->out), "%s", value);
+	else if (!strcmp(key, "size"))
+		job->fontSize = strtol(value, &end, 0);
+	else if (!strcmp(key, "yshift"))
+		job->yshift = strtol(value, &end, 0);
+	else if (!strcmp(key, "xpad"))
+		job->xPad = strtol(value, &end, 0);
+	else if (!strcmp(key, "advance"))
+		job->widthAdvance = strtol(value, &end, 0);
+	else if (!strcmp(key, "oversample"))
+		job->oversample = strtol(value, &end, 0);
+	else if (!strcmp(key, "sdf"))
+		job->isSdf = strtol(value, &end, 0);
+	else if (!strcmp(key, "weight"))
+		job->weight = strtol(value, &end, 0);
+	else if (!strcmp(key, "gamma"))
+		job->gamma = strtof(value, &end);
+	else if (!strcmp(key, "contrast"))
+		job->contrast = strtof(value, &end);
+	else if (!strcmp(key, "quantizer"))
+	{
+		for (job->quantizer = 0; job->quantizer < Z64FONT_QUANTIZE_NUM; ++job->quantizer)
+			if (!strcmp(value, z64font_quantizerName(job->quantizer)))
+				break;
+		if (job->quantizer == Z64FONT_QUANTIZE_NUM)
+			goto L_bad;
+	}
+	else
+		goto L_bad;
+	
+	if (end && (end == value || *end))
+		goto L_bad;
+	return 0;
+L_bad:
+	wow_stderr("%s:%d: bad or unknown setting '%s = %s'\n", run->fn, line, key, value);
+	return -1;
+}
+
+static struct batchFont *fontFor(struct batchRun *run, const char *fn)
+{
+	struct z64font g = { .info = quiet, .error = z64font_stderr };
+	struct batchFont *font;
+	int i;
+	
+	for (i = 0; i < run->fontNum; ++i)
+		if (!strcmp(run->font[i].fn, fn))
+			return &run->font[i];
+	
+	if (z64font_loadFont(&g, fn))
+		return 0;
+	
+	font = &run->font[run->fontNum++];
+	font->fn = fn;
+	font->ttfBin = g.ttfBin;
+	font->ttfBinSz = g.ttfBinSz;
+	font->info = g.font;
+	
+	return font;
+}
+
+static struct batchCharset *charsetFor(struct batchRun *run, const char *fn)
+{
+	struct z64font g = { .info = quiet, .error = z64font_stderr };
+	struct batchCharset *charset;
+	int i;
+	
+	for (i = 0; i < run->charsetNum; ++i)
+		if (!strcmp(run->charset[i].fn, fn))
+			return &run->charset[i];
+	
+	if (z64font_loadCodepoints(&g, fn))
+	{
+		free(g.chars);
+		return 0;
+	}
+	
+	charset = &run->charset[run->charsetNum++];
+	charset->fn = fn;
+	charset->chars = g.chars;
+	
+	return charset;
+}
+
+static struct batchIndex *indexFor(
+	struct batchRun *run
+	, struct batchFont *font
+	, struct batchCharset *charset
+)
+{
+	struct batchIndex *index;
+	int i;
+	
+	for (i = 0; i < run->indexNum; ++i)
+		if (run->index[i].font == font && run->index[i].charset == charset)
+			return &run->index[i];
+	
+	index = &run->index[run->indexNum++];
+	index->font = font;
+	index->charset = charset;
+	pthread_mutex_init(&index->lock, 0);
+	
+	return index;
+}
+
+/* the task whose jobs rasterize like 'job' does */
+static struct batchTask *taskFor(
+	struct batchRun *run
+	, struct batchIndex *index
+	, const struct batchJob *job
+)
+{
+	struct batchTask *task;
+	int i;
+	
+	for (i = 0; i < run->taskNum; ++i)
+	{
+		const struct batchJob *b = run->task[i].job[0];
+		
+		task = &run->task[i];
+		if (task->index == index
+			&& b->fontSize == job->fontSize
+			&& b->oversample == job->oversample
+			&& b->isSdf == job->isSdf
+			&& (!job->isSdf || b->weight == job->weight)
+		)
+			return task;
+	}
+	
+	task = &run->task[run->taskNum++];
+	task->index = index;
+	task->job = wow_calloc_die(run->jobNum, sizeof(*task->job));
+	
+	return task;
+}
+
+/* resolves each job's targets and groups jobs into tasks, loading
+ * every font and codepoint file along the way
+ */
+static int plan(struct batchRun *run)
+{
+	int i;
+	
+	run->font = wow_calloc_die(run->jobNum, sizeof(*run->font));
+	run->charset = wow_calloc_die(run->jobNum, sizeof(*run->charset));
+	run->index = wow_calloc_die(run->jobNum, sizeof(*run->index));
+	run->task = wow_calloc_die(run->jobNum, sizeof(*run->task));
+	
+	for (i = 0; i < run->jobNum; ++i)
+	{
+		struct batchJob *job = &run->job[i];
+		struct batchFont *font;
+		struct batchCharset *charset;
+		struct batchTask *task;
+		const char *s = job->targets;
+		
+		if (!*job->font || !*job->codepoints || !*job->targets || !*job->out)
+		{
+			wow_stderr("%s:%d: job '%s' needs font, codepoints, targets and out\n"
+				, run->fn, job->line, job->name
+			);
+			return -1;
+		}
+		
+		while (*s)
+		{
+			char name[64];
+			int len = strcspn(s, ", ");
+			int k;
+			
+			snprintf(name, sizeof(name), "%.*s", len, s);
+			s += len + strspn(s + len, ", ");
+			if (job->targetNum == BATCH_TARGET_MAX
+				|| !(job->target[job->targetNum] = profile_find(&run->profiles, name))
+			)
+			{
+				wow_stderr("%s:%d: unknown or too many targets at '%s'\n"
+					, run->fn, job->line, name
+				);
+				return -1;
+			}
+			for (k = 0; k < job->targetNum; ++k)
+				if (job->target[k] == job->target[job->targetNum])
+					break;
+			if (k < job->targetNum)
+			{
+				wow_stderr("%s:%d: target '%s' is listed twice\n", run->fn, job->line, name);
+				return -1;
+			}
+			if (job->target[job->targetNum++]->isDecomp && !*job->names)
+			{
+				wow_stderr("%s:%d: target '%s' needs names\n", run->fn, job->line, name);
+				return -1;
+			}
+		}
+		
+		if (!(font = fontFor(run, job->font))
+			|| !(charset = charsetFor(run, job->codepoints))
+		)
+			return -1;
+		
+		task = taskFor(run, indexFor(run, font, charset), job);
+		task->job[task->jobNum++] = job;
+		task->cost += strlen(charset->chars);
+	}
+	
+	return 0;
+}
+
+static int resolveIndex(struct batchIndex *index)
+{
+	pthread_mutex_lock(&index->lock);
+	if (!index->isReady)
+	{
+		struct z64font g = {
+			.ttfBin = index->font->ttfBin
+			, .ttfBinSz = index->font->ttfBinSz
+			, .font = index->font->info
+			, .chars = index->charset->chars
+			, .zchar = wow_calloc_die(ZCHAR_MAX, sizeof(struct zchar))
+			, .info = quiet
+			, .error = z64font_stderr
+		};
+		
+		index->failed = z64font_resolve(&g);
+		index->zchar = g.zchar;
+		index->zcharNum = g.zcharNum;
+		index->isReady = 1;
+	}
+	pthread_mutex_unlock(&index->lock);
+	
+	return index->failed;
+}
+
+static void runTask(struct batchTask *task)
+{
+	struct batchIndex *index = task->index;
+	struct z64font_stats stats;
+	struct z64font src = {
+		.ttfBin = index->font->ttfBin
+		, .ttfBinSz = index->font->ttfBinSz
+		, .font = index->font->info
+		, .chars = index->charset->chars
+		, .info = quiet
+		, .error = z64font_stderr
+	};
+	struct z64font g;
+	int i;
+	
+	/* the task's own copy of the shared font and resolved codepoints */
+	if (!resolveIndex(index))
+	{
+		src.zchar = index->zchar;
+		src.zcharNum = index->zcharNum;
+		src.isResolved = 1;
+	}
+	if (!src.isResolved || z64font_share(&g, &src))
+	{
+		for (i = 0; i < task->jobNum; ++i)
+			task->job[i]->failed = 1;
+		return;
+	}
+	g.stats = &stats;
+	
+	for (i = 0; i < task->jobNum; ++i)
+	{
+		struct batchJob *job = task->job[i];
+		double t = z64font_seconds();
+		
+		g.fontSize = job->fontSize;
+		g.yshift = job->yshift;
+		g.xPad = job->xPad;
+		g.widthAdvance = job->widthAdvance;
+		g.oversample = job->oversample;
+		g.isSdf = job->isSdf;
+		g.weight = job->weight;
+		g.quantizer = job->quantizer;
+		g.gamma = job->gamma;
+		g.contrast = job->contrast;
+		
+		memset(&stats, 0, sizeof(stats));
+		job->failed = (*job->names && z64font_loadDecompFileNames(&g, job->names))
+			|| z64font_convert(&g)
+			|| z64font_exportTargets(&g, job->target, job->targetNum, job->out);
+		job->seconds = z64font_seconds() - t;
+		job->glyphs = g.zcharNum;
+		job->rasterHits = stats.rasterHits;
+		job->rasterMisses = stats.rasterMisses;
+	}
+	
+	z64font_free(&g);
+}
+
+/* own tasks first; once those run out, steal from the others */
+static struct batchTask *takeTask(struct batchWorker *w)
+{
+	struct batchRun *run = w->run;
+	int i;
+	
+	for (i = 0; i < run->workerNum; ++i)
+	{
+		struct batchDeque *d = &run->deque[(w->self + i) % run->workerNum];
+		struct batchTask *task = 0;
+		
+		pthread_mutex_lock(&d->lock);
+		if (d->head < d->tail)
+			task = i ? d->task[--d->tail] : d->task[d->head++];
+		pthread_mutex_unlock(&d->lock);
+		
+		if (task)
+		{
+			w->steals += i != 0;
+			return task;
+		}
+	}
+	
+	return 0;
+}
+
+static void *workerThreadFunc(void *udata)
+{
+	struct batchWorker *w = udata;
+	struct batchTask *task;
+	
+	while ((task = takeTask(w)))
+		runTask(task);
+	
+	return 0;
+}
+
+static int compareTaskCost(const void *a_, const void *b_)
+{
+	const struct batchTask *a = *(struct batchTask * const*)a_;
+	const struct batchTask *b = *(struct batchTask * const*)b_;
+	
+	return (a->cost < b->cost) - (a->cost > b->cost);
+}
+
+/* deals the tasks out largest first, then lets the workers at them */
+static int schedule(struct batchRun *run, int threads)
+{
+	struct batchTask **order = wow_malloc_die(run->taskNum * sizeof(*order));
+	struct batchWorker *w;
+	int steals = 0;
+	int i;
+	
+	run->workerNum = threads < run->taskNum ? threads : run->taskNum;
+	run->deque = wow_calloc_die(run->workerNum, sizeof(*run->deque));
+	for (i = 0; i < run->workerNum; ++i)
+	{
+		run->deque[i].task = wow_malloc_die(run->taskNum * sizeof(*run->deque[i].task));
+		pthread_mutex_init(&run->deque[i].lock, 0);
+	}
+	
+	for (i = 0; i < run->taskNum; ++i)
+		order[i] = &run->task[i];
+	qsort(order, run->taskNum, sizeof(*order), compareTaskCost);
+	for (i = 0; i < run->taskNum; ++i)
+	{
+		struct batchDeque *d = &run->deque[i % run->workerNum];
+		
+		d->task[d->tail++] = order[i];
+	}
+	
+	w = wow_calloc_die(run->workerNum, sizeof(*w));
+	for (i = 0; i < run->workerNum; ++i)
+	{
+		w[i].run = run;
+		w[i].self = i;
+		w[i].isThread = !pthread_create(&w[i].tid, 0, workerThreadFunc, &w[i]);
+	}
+	
+	/* whatever couldn't get a thread is worked through on this one */
+	for (i = 0; i < run->workerNum; ++i)
+		if (!w[i].isThread)
+			workerThreadFunc(&w[i]);
+	
+	for (i = 0; i < run->workerNum; ++i)
+	{
+		if (w[i].isThread)
+			pthread_join(w[i].tid, 0);
+		steals += w[i].steals;
+		pthread_mutex_destroy(&run->deque[i].lock);
+		free(run->deque[i].task);
+	}
+	
+	free(w);
+	free(order);
+	free(run->deque);
+	
+	return steals;
+}
+
+int batch_run(const struct batch_options *opt, FILE *out)
+{
+	struct batchRun run = { .fn = opt->manifest, .defaults = { .fontSize = 16 } };
+	int threads = opt->threads > 0 ? opt->threads : z64font_threadCount();
+	double start = z64font_seconds();
+	int failedNum = 0;
+	int steals = 0;
+	int i;
+	
+	if (profile_loadDir(&run.profiles, opt->profileDir, wow_stderr)
+		|| ini_parseFile(opt->manifest, onKey, &run, wow_stderr)
+		|| plan(&run)
+	)
+	{
+		failedNum = -1;
+		goto L_cleanup;
+	}
+	
+	if (run.taskNum)
+		steals = schedule(&run, threads);
+	
+	for (i = 0; i < run.jobNum; ++i)
+	{
+		const struct batchJob *job = &run.job[i];
+		
+		failedNum += job->failed;
+		fprintf(out
+			, "job=%s size=%d targets=%d glyphs=%u raster_hits=%u"
+			" raster_misses=%u wall_ms=%.3f status=%s\n"
+			, job->name
+			, job->fontSize
+			, job->targetNum
+			, job->glyphs
+			, job->rasterHits
+			, job->rasterMisses
+			, job->seconds * 1000
+			, job->failed ? "failed" : "ok"
+		);
+	}
+	fprintf(out
+		, "jobs=%d failed=%d fonts=%d codepoint_files=%d tasks=%d"
+		" threads=%d steals=%d wall_ms=%.3f\n"
+		, run.jobNum
+		, failedNum
+		, run.fontNum
+		, run.charsetNum
+		, run.taskNum
+		, run.workerNum
+		, steals
+		, (z64font_seconds() - start) * 1000
+	);
+	
+L_cleanup:
+	for (i = 0; i < run.fontNum; ++i)
+		free(run.font[i].ttfBin);
+	for (i = 0; i < run.charsetNum; ++i)
+		free(run.charset[i].chars);
+	for (i = 0; i < run.indexNum; ++i)
+	{
+		free(run.index[i].zchar);
+		pthread_mutex_destroy(&run.index[i].lock);
+	}
+	for (i = 0; i < run.taskNum; ++i)
+		free(run.task[i].job);
+	free(run.font);
+	free(run.charset);
+	free(run.index);
+	free(run.task);
+	free(run.job);
+	profile_free(&run.profiles);
+	
+	return failedNum ? -1 : 0;
+}
+
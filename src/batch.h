@@ -0,0 +1,27 @@
+/* <z64.me> manifest-driven batch conversion */
+
+#ifndef Z64_BATCH_H_INCLUDED
+#define Z64_BATCH_H_INCLUDED
+
+#include <stdio.h>
+
+#define  BATCH_TARGET_MAX 16   /* targets a job may list */
+
+struct batch_options
+{
+	const char *manifest;   /* ini file; one [section] per job */
+	const char *profileDir; /* where target profiles are read from */
+	int threads;            /* 0 = one per core */
+};
+
+/* runs every job in the manifest in one process; each font and
+ * codepoint file is loaded once, codepoints are mapped to glyphs once
+ * per font and codepoint file pair, and jobs sharing a rasterization
+ * (font, codepoints, size and rasterizer settings) reuse one raster
+ * cache; prints one line of key=value pairs per job, in manifest
+ * order, then a summary line; returns non-zero if any job failed
+ */
+int batch_run(const struct batch_options *opt, FILE *out);
+
+#endif
+
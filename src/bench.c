@@ -0,0 +1,378 @@
+/* <z64.me> conversion and export benchmarks */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <wow.h>
+
+#include "z64font.h"
+#include "bench.h"
+
+/* a workload is split into chunks of at most ZCHAR_MAX codepoints */
+struct workload
+{
+	char name[64];
+	char **chunk;  /* codepoint file contents */
+	int chunkNum;
+};
+
+static void quiet(void *udata, const char *fmt, ...)
+{
+	(void)udata;
+	(void)fmt;
+}
+
+static const char *baseName(const char *fn)
+{
+	const char *slash = strrchr(fn, '/');
+	const char *bslash = strrchr(fn, '\\');
+	
+	if (bslash > slash)
+		slash = bslash;
+	return slash ? slash + 1 : fn;
+}
+
+static int compareDouble(const void *a_, const void *b_)
+{
+	double a = *(const double*)a_;
+	double b = *(const double*)b_;
+	
+	return (a > b) - (a < b);
+}
+
+/* nearest-rank percentile of sorted samples */
+static double percentile(const double *sorted, int num, int pct)
+{
+	int idx = (pct * num + 99) / 100 - 1;
+	
+	if (idx < 0)
+		idx = 0;
+	return sorted[idx];
+}
+
+/* appends one codepoint to a growing string */
+static void appendCodepoint(char **dst, int cp)
+{
+	char *c = *dst;
+	
+	if (cp < 0x800)
+	{
+		*c++ = 0xc0 | (cp >> 6);
+		*c++ = 0x80 | (cp & 0x3f);
+	}
+	else
+	{
+		*c++ = 0xe0 | (cp >> 12);
+		*c++ = 0x80 | ((cp >> 6) & 0x3f);
+		*c++ = 0x80 | (cp & 0x3f);
+	}
+	*dst = c;
+}
+
+/* synthetic charset spanning the cjk unified ideographs block */
+static void makeCjkWorkload(struct workload *w)
+{
+	int per = ZCHAR_MAX;
+	int i;
+	
+	snprintf(w->name, sizeof(w->name), "cjk%dk", BENCH_CJK_NUM / 1000);
+	w->chunkNum = (BENCH_CJK_NUM + per - 1) / per;
+	w->chunk = wow_calloc_die(w->chunkNum, sizeof(*w->chunk));
+	
+	for (i = 0; i < w->chunkNum; ++i)
+	{
+		int first = 0x4e00 + i * per;
+		int num = BENCH_CJK_NUM - i * per < per ? BENCH_CJK_NUM - i * per : per;
+		char *c;
+		int k;
+		
+		/* sample line, then one codepoint per line */
+		c = w->chunk[i] = wow_malloc_die((num + 16) * 4 + 1);
+		for (k = 0; k < 16 && k < num; ++k)
+			appendCodepoint(&c, first + k);
+		*c++ = '\n';
+		for (k = 0; k < num; ++k)
+		{
+			appendCodepoint(&c, first + k);
+			*c++ = '\n';
+		}
+		*c = '\0';
+	}
+}
+
+static int loadWorkload(struct workload *w, const char *fn)
+{
+	struct z64font g = { .error = z64font_stderr };
+	const char *ext;
+	
+	if (z64font_loadCodepoints(&g, fn))
+	{
+		free(g.chars);
+		return -1;
+	}
+	
+	snprintf(w->name, sizeof(w->name), "%s", baseName(fn));
+	if ((ext = strrchr(w->name, '.')))
+		*(char*)ext = '\0';
+	w->chunkNum = 1;
+	w->chunk = wow_malloc_die(sizeof(*w->chunk));
+	w->chunk[0] = g.chars;
+	
+	return 0;
+}
+
+/* decomp png names for every slot of a chunk */
+static char *makeDecompNames(const char *outDir, int chunk)
+{
+	size_t len = strlen(outDir) + 32;
+	char *names = wow_malloc_die(len * ZCHAR_MAX + 1);
+	char *c = names;
+	int i;
+	
+	for (i = 0; i < ZCHAR_MAX; ++i)
+		c += sprintf(c, "%s/bench_%d_%04d.png\n", outDir, chunk, i);
+	
+	return names;
+}
+
+static void printOp(
+	FILE *out
+	, const char *prefix
+	, const char *op
+	, double *lat
+	, int num
+	, unsigned glyphs
+)
+{
+	qsort(lat, num, sizeof(*lat), compareDouble);
+	
+	fprintf(out
+		, "%s op=%s n=%d glyphs=%u p50_ms=%.3f p90_ms=%.3f p99_ms=%.3f"
+		" max_ms=%.3f glyphs_per_s=%.0f\n"
+		, prefix
+		, op
+		, num
+		, glyphs
+		, percentile(lat, num, 50) * 1000
+		, percentile(lat, num, 90) * 1000
+		, percentile(lat, num, 99) * 1000
+		, lat[num - 1] * 1000
+		, glyphs / percentile(lat, num, 50)
+	);
+}
+
+static void printStages(
+	FILE *out
+	, const char *prefix
+	, const char *op
+	, const struct z64font_stats *st
+	, unsigned glyphs
+)
+{
+	int i;
+	
+	for (i = 0; i < Z64FONT_STAGE_NUM; ++i)
+	{
+		if (st->wall[i] <= 0)
+			continue;
+		
+		fprintf(out
+			, "%s op=%s stage=%s wall_ms=%.3f cpu_ms=%.3f"
+			" glyphs_per_s=%.0f mb_per_s=%.3f\n"
+			, prefix
+			, op
+			, z64font_stageName(i)
+			, st->wall[i] * 1000
+			, st->cpu[i] * 1000
+			, glyphs / st->wall[i]
+			, i == Z64FONT_STAGE_ENCODE || i == Z64FONT_STAGE_WRITE
+				? st->bytesWritten / 1e6 / st->wall[i]
+				: 0
+		);
+	}
+}
+
+static int benchOne(
+	const struct bench_options *opt
+	, FILE *out
+	, const struct z64font *font
+	, const char *fontName
+	, const struct workload *w
+	, int size
+)
+{
+	struct z64font *g = wow_calloc_die(w->chunkNum, sizeof(*g));
+	struct z64font_stats stats;
+	double *lat = wow_malloc_die(opt->iterations * sizeof(*lat));
+	char prefix[256];
+	const char *op = "convert";
+	unsigned glyphs = 0;
+	int failed;
+	int rval = -1;
+	int it;
+	int i;
+	
+	snprintf(prefix, sizeof(prefix), "font=%s workload=%s size=%d"
+		, fontName, w->name, size
+	);
+	
+	/* every chunk shares the already loaded font */
+	for (i = 0; i < w->chunkNum; ++i)
+	{
+		struct z64font src = *font;
+		int failed;
+		
+		src.chars = w->chunk[i];
+		src.decompFileNames = makeDecompNames(opt->outDir, i);
+		src.fontSize = size;
+		src.info = quiet;
+		failed = z64font_share(&g[i], &src);
+		free(src.decompFileNames);
+		if (failed)
+		{
+			while (i--)
+				z64font_free(&g[i]);
+			free(g);
+			free(lat);
+			return -1;
+		}
+		g[i].stats = &stats;
+	}
+	
+	/* cold conversions: nothing cached, codepoints re-parsed */
+	memset(&stats, 0, sizeof(stats));
+	for (it = 0; it < opt->iterations; ++it)
+	{
+		double t = z64font_seconds();
+		
+		for (i = 0; i < w->chunkNum; ++i)
+		{
+			z64font_flushRasters(&g[i]);
+			g[i].isResolved = 0;
+			if (z64font_convert(&g[i]))
+				goto L_failed;
+		}
+		lat[it] = z64font_seconds() - t;
+	}
+	for (i = 0; i < w->chunkNum; ++i)
+		glyphs += g[i].zcharNum;
+	printOp(out, prefix, "convert", lat, opt->iterations, glyphs);
+	printStages(out, prefix, "convert", &stats, glyphs * opt->iterations);
+	
+	memset(&stats, 0, sizeof(stats));
+	for (it = 0; it < opt->iterations; ++it)
+	{
+		double t = z64font_seconds();
+		
+		for (i = 0; i < w->chunkNum; ++i)
+		{
+			char *ofn = wow_malloc_die(strlen(opt->outDir) + 32);
+			
+			sprintf(ofn, "%s/bench_%d.bin", opt->outDir, i);
+			op = "exportBinaries";
+			failed = z64font_exportBinaries(&g[i], &ofn);
+			free(ofn);
+			if (failed)
+				goto L_failed;
+		}
+		lat[it] = z64font_seconds() - t;
+	}
+	printOp(out, prefix, "exportBinaries", lat, opt->iterations, glyphs);
+	printStages(out, prefix, "exportBinaries", &stats, glyphs * opt->iterations);
+	
+	memset(&stats, 0, sizeof(stats));
+	for (it = 0; it < opt->iterations; ++it)
+	{
+		double t = z64font_seconds();
+		
+		for (i = 0; i < w->chunkNum; ++i)
+		{
+			char *ofn = wow_malloc_die(strlen(opt->outDir) + 32);
+			
+			sprintf(ofn, "%s/bench_%d.font_width.h", opt->outDir, i);
+			op = "exportDecomp";
+			failed = z64font_exportDecomp(&g[i], &ofn);
+			free(ofn);
+			if (failed)
+				goto L_failed;
+		}
+		lat[it] = z64font_seconds() - t;
+	}
+	printOp(out, prefix, "exportDecomp", lat, opt->iterations, glyphs);
+	printStages(out, prefix, "exportDecomp", &stats, glyphs * opt->iterations);
+	rval = 0;
+	
+L_cleanup:
+	for (i = 0; i < w->chunkNum; ++i)
+		z64font_free(&g[i]);
+	free(g);
+	free(lat);
+	
+	return rval;
+
+L_failed:
+	/* the reason went to stderr through the error callback */
+	fprintf(out, "%s op=%s failed=1\n", prefix, op);
+	goto L_cleanup;
+}
+
+int bench_run(const struct bench_options *opt, FILE *out)
+{
+	struct workload *w;
+	int wNum = opt->codepointsNum + 1;
+	int rval = 0;
+	int i;
+	
+	if (opt->iterations < 1 || opt->sizesNum < 1)
+		return -1;
+	
+	w = wow_calloc_die(wNum, sizeof(*w));
+	for (i = 0; i < opt->codepointsNum; ++i)
+	{
+		if (loadWorkload(&w[i], opt->codepoints[i]))
+		{
+			rval = -1;
+			goto L_cleanup;
+		}
+	}
+	makeCjkWorkload(&w[wNum - 1]);
+	
+	for (i = 0; i < opt->ttfNum; ++i)
+	{
+		struct z64font font = { .error = z64font_stderr };
+		int k;
+		
+		if (z64font_loadFont(&font, opt->ttf[i]))
+		{
+			rval = -1;
+			break;
+		}
+		
+		for (k = 0; k < wNum && !rval; ++k)
+		{
+			int s;
+			
+			for (s = 0; s < opt->sizesNum && !rval; ++s)
+				rval = benchOne(opt, out, &font, baseName(opt->ttf[i]), &w[k], opt->sizes[s]);
+		}
+		
+		z64font_free(&font);
+		if (rval)
+			break;
+	}
+
+L_cleanup:
+	for (i = 0; i < wNum; ++i)
+	{
+		int k;
+		
+		for (k = 0; k < w[i].chunkNum; ++k)
+			free(w[i].chunk[k]);
+		free(w[i].chunk);
+	}
+	free(w);
+	
+	return rval;
+}
+
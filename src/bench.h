@@ -0,0 +1,30 @@
+/* <z64.me> conversion and export benchmarks */
+
+#ifndef Z64_BENCH_H_INCLUDED
+#define Z64_BENCH_H_INCLUDED
+
+#include <stdio.h>
+
+#define  BENCH_SIZES_MAX 16
+#define  BENCH_CJK_NUM 20000   /* codepoints in synthetic cjk workload */
+
+struct bench_options
+{
+	const char **ttf;       /* fonts to benchmark */
+	int ttfNum;
+	const char **codepoints; /* codepoint files used as workloads */
+	int codepointsNum;
+	int sizes[BENCH_SIZES_MAX];
+	int sizesNum;
+	int iterations;
+	const char *outDir;     /* exports are written (and overwritten) here */
+};
+
+/* runs every font x workload x size combination, printing one line of
+ * space-separated key=value pairs per measurement; the synthetic cjk
+ * workload is always included; returns non-zero on failure
+ */
+int bench_run(const struct bench_options *opt, FILE *out);
+
+#endif
+
@@ -0,0 +1,699 @@
+/* <z64.me> z64font's command line interface lives here */
+
+#ifndef Z64FONT_GUI
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define WOW_IMPLEMENTATION
+#include <wow.h>
+
+#include "z64font.h"
+#include "scan.h"
+#include "bench.h"
+#include "golden.h"
+#include "fit.h"
+#include "profile.h"
+#include "batch.h"
+#include "watch.h"
+#include "server.h"
+
+static void showUsage(void)
+{
+	fprintf(stderr,
+		PROG_NAME_VER_ATTRIB"\n"
+		"usage:\n"
+		"  z64font convert [options] font.ttf codepoints.txt out\n"
+		"    converts a font and exports out.font_static and out.width_table\n"
+		"    -s size       font size (default 16)\n"
+		"    -y yshift     vertical shift\n"
+		"    -x xpad       extra horizontal spacing\n"
+		"    -r            right to left\n"
+		"    -a            width is the glyph's advance\n"
+		"    -O n          rasterize n times larger and box filter it down\n"
+		"                  (2, 4 or 8 evens out stem weights at small sizes)\n"
+		"    -q quantizer  how glyphs are reduced to i4: nearest (default),\n"
+		"                  bayer, floyd or atkinson\n"
+		"    -g gamma      tone curve applied before quantizing; > 1 brightens\n"
+		"    -c contrast   scales contrast about mid gray, after gamma\n"
+		"    -F            reconstruct glyphs from signed distance fields\n"
+		"    -w weight     with -F, grow (or shrink, if negative) strokes by\n"
+		"                  this many tenths of a pixel, -10 to 10\n"
+		"    -d names.txt  export for decomp instead; out is font_width.h\n"
+		"    -S stats.json write stage timings and counters as json\n"
+		"    -R report.txt write every glyph's ink bounds and clipped pixels;\n"
+		"                  exits with 2 if any glyph clips\n"
+		"    -m bytes      fail instead of using more memory than this;\n"
+		"                  accepts k, m and g suffixes\n"
+		"    -t targets    comma-separated profile names, e.g. oot-debug,\n"
+		"                  mm-usa or oot-decomp (needs -d); converts once\n"
+		"                  and writes out.target.font_static etc for each\n"
+		"    -p dir        where target profiles are read from\n"
+		"                  (default profiles)\n"
+		"  z64font watch [options] font.ttf codepoints.txt out\n"
+		"    exports like convert (taking the same options, save for -S\n"
+		"    and -R), then again whenever the font, codepoints or names\n"
+		"    file is saved; only new glyphs are rasterized and only files\n"
+		"    whose contents change are rewritten\n"
+		"    -b ms         wait this long for a burst of saves to end\n"
+		"                  (default 200)\n"
+		"  z64font bench [options] font.ttf...\n"
+		"    measures conversion and export throughput; reports one line of\n"
+		"    key=value pairs per measurement, including a synthetic 20k\n"
+		"    codepoint cjk workload\n"
+		"    -n iterations  per measurement (default 10)\n"
+		"    -s sizes       comma-separated font sizes (default 12,16,24)\n"
+		"    -c file.txt    codepoint file workload, repeatable (default\n"
+		"                   codepoints/oot.txt and codepoints/mm.txt)\n"
+		"    -o dir         where exports are written (default .)\n"
+		"  z64font golden [options] font.ttf...\n"
+		"    renders every font and codepoint file over a matrix of sizes,\n"
+		"    yshifts, xpads, advance and rtl settings, printing hashes of\n"
+		"    everything exported; save the output before changing the\n"
+		"    conversion code, then check the change against it with -g\n"
+		"    -g golden.txt  report combinations whose output differs\n"
+		"    -c file.txt    codepoint file, repeatable (default\n"
+		"                   codepoints/oot.txt and codepoints/mm.txt)\n"
+		"    -o dir         scratch directory for exports (default .)\n"
+		"  z64font fit [options] font.ttf codepoints.txt\n"
+		"    finds the largest font size, and the yshift for it, at which\n"
+		"    glyphs fit the cell; lists what's clipped at every size tried\n"
+		"    -t tolerance   glyphs allowed to clip (default 0)\n"
+		"    -r min-max     font sizes to try (default 4-32)\n"
+		"    -j threads     (default: one per core)\n"
+		"  z64font batch [-j threads] [-p dir] manifest.ini\n"
+		"    runs every job in an ini manifest, one [section] per job, with\n"
+		"    keys font, codepoints, targets and out, plus size, yshift,\n"
+		"    xpad, advance, oversample, quantizer, gamma, contrast, sdf,\n"
+		"    weight and names (for decomp targets) as in convert; keys\n"
+		"    before the first section apply to every job; fonts, codepoint\n"
+		"    files and rasterized glyphs are shared between jobs\n"
+		"    -j threads     (default: one per core)\n"
+		"    -p dir         where target profiles are read from\n"
+		"                   (default profiles)\n"
+		"  z64font serve socket.path\n"
+		"    answers render and widths requests from editors and tools\n"
+		"    over a unix domain socket, one json object per line; fonts,\n"
+		"    codepoint files and converted glyphs stay loaded between\n"
+		"    requests, and are reloaded if they change on disk\n"
+		"  z64font scan [-j threads] [-m slotmap.txt] [-o out.txt] dump.txt...\n"
+		"    counts codepoint usage across UTF-8 message dumps and writes\n"
+		"    a minimal codepoint file; with -m, the slots of an existing\n"
+		"    codepoint file keep their order and new codepoints follow\n"
+	);
+}
+
+static char *readText(const char *fn)
+{
+	FILE *fp = fopen(fn, "rb");
+	char *data;
+	long sz;
+	
+	if (!fp)
+		return 0;
+	fseek(fp, 0, SEEK_END);
+	sz = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	data = wow_malloc_die(sz + 1);
+	if (fread(data, 1, sz, fp) != (size_t)sz)
+	{
+		fclose(fp);
+		free(data);
+		return 0;
+	}
+	data[sz] = '\0';
+	fclose(fp);
+	return data;
+}
+
+/* fall back to the shipped codepoint files, where present */
+static int defaultCodepoints(const char **dst)
+{
+	static const char *fn[] = {
+		"codepoints/oot.txt"
+		, "codepoints/mm.txt"
+	};
+	int num = 0;
+	int i;
+	
+	for (i = 0; i < 2; ++i)
+	{
+		FILE *fp = fopen(fn[i], "rb");
+		
+		if (fp)
+		{
+			dst[num++] = fn[i];
+			fclose(fp);
+		}
+	}
+	
+	return num;
+}
+
+static int cmdScan(int argc, char **argv)
+{
+	const char *outFn = 0;
+	char *slotMap = 0;
+	uint64_t *count;
+	FILE *fp = stdout;
+	int threads = 0;
+	int rval = EXIT_FAILURE;
+	int i;
+	
+	for (i = 0; i < argc && argv[i][0] == '-'; ++i)
+	{
+		const char *arg = argv[i];
+		
+		if (i + 1 >= argc)
+			break;
+		
+		if (!strcmp(arg, "-j"))
+			threads = atoi(argv[++i]);
+		else if (!strcmp(arg, "-o"))
+			outFn = argv[++i];
+		else if (!strcmp(arg, "-m"))
+		{
+			if (!(slotMap = readText(argv[++i])))
+			{
+				wow_stderr("failed to read '%s'\n", argv[i]);
+				return EXIT_FAILURE;
+			}
+		}
+		else
+			break;
+	}
+	
+	if (i >= argc)
+	{
+		showUsage();
+		free(slotMap);
+		return EXIT_FAILURE;
+	}
+	
+	count = wow_malloc_die(SCAN_CODEPOINT_MAX * sizeof(*count));
+	if (scan_files((const char**)argv + i, argc - i, threads, count, wow_stderr))
+		goto L_cleanup;
+	
+	if (outFn && !(fp = fopen(outFn, "wb")))
+	{
+		wow_stderr("failed to open '%s' for writing\n", outFn);
+		goto L_cleanup;
+	}
+	
+	if (scan_writeCodepoints(fp, count, slotMap, wow_stderr))
+		wow_stderr("failed to write codepoints\n");
+	else
+		rval = EXIT_SUCCESS;
+
+L_cleanup:
+	if (fp && fp != stdout)
+		fclose(fp);
+	free(slotMap);
+	free(count);
+	return rval;
+}
+
+static int cmdConvert(int argc, char **argv, int isWatch)
+{
+	struct z64font g = Z64FONT_DEFAULTS;
+	struct z64font_stats stats = {0};
+	const char *decompNames = 0;
+	const char *statsFn = 0;
+	const char *reportFn = 0;
+	const char *targetNames = 0;
+	const char *profileDir = "profiles";
+	struct profile_table profiles = {0};
+	int debounceMs = 0;
+	const struct z64font_target *target[16];
+	int targetNum = 0;
+	char *ofn;
+	int rval = EXIT_FAILURE;
+	int i;
+	
+	for (i = 0; i < argc && argv[i][0] == '-'; ++i)
+	{
+		const char *arg = argv[i];
+		
+		if (!strcmp(arg, "-r"))
+			g.rightToLeft = 1;
+		else if (!strcmp(arg, "-a"))
+			g.widthAdvance = 1;
+		else if (!strcmp(arg, "-F"))
+			g.isSdf = 1;
+		else if (i + 1 >= argc)
+			break;
+		else if (!strcmp(arg, "-s"))
+			g.fontSize = atoi(argv[++i]);
+		else if (!strcmp(arg, "-y"))
+			g.yshift = atoi(argv[++i]);
+		else if (!strcmp(arg, "-x"))
+			g.xPad = atoi(argv[++i]);
+		else if (!strcmp(arg, "-O"))
+			g.oversample = atoi(argv[++i]);
+		else if (!strcmp(arg, "-w"))
+			g.weight = atoi(argv[++i]);
+		else if (!strcmp(arg, "-g"))
+			g.gamma = atof(argv[++i]);
+		else if (!strcmp(arg, "-c"))
+			g.contrast = atof(argv[++i]);
+		else if (!strcmp(arg, "-q"))
+		{
+			for (g.quantizer = 0; g.quantizer < Z64FONT_QUANTIZE_NUM; ++g.quantizer)
+				if (!strcmp(argv[i + 1], z64font_quantizerName(g.quantizer)))
+					break;
+			if (g.quantizer == Z64FONT_QUANTIZE_NUM)
+			{
+				wow_stderr("unknown quantizer '%s'\n", argv[i + 1]);
+				free(g.zchar);
+				return EXIT_FAILURE;
+			}
+			++i;
+		}
+		else if (!strcmp(arg, "-t"))
+			targetNames = argv[++i];
+		else if (!strcmp(arg, "-p"))
+			profileDir = argv[++i];
+		else if (!strcmp(arg, "-b"))
+			debounceMs = atoi(argv[++i]);
+		else if (!strcmp(arg, "-d"))
+			decompNames = argv[++i];
+		else if (!strcmp(arg, "-S"))
+			statsFn = argv[++i];
+		else if (!strcmp(arg, "-R"))
+			reportFn = argv[++i];
+		else if (!strcmp(arg, "-m"))
+		{
+			const char *num = argv[++i];
+			char *end;
+			
+			g.memBudget = strtoull(num, &end, 10);
+			switch (*end)
+			{
+				case 'g': case 'G': g.memBudget <<= 10; /* fallthrough */
+				case 'm': case 'M': g.memBudget <<= 10; /* fallthrough */
+				case 'k': case 'K': g.memBudget <<= 10; ++end;
+			}
+			
+			/* digits and at most one suffix; '64x' or 'foo' isn't a budget */
+			if (*num < '0' || *num > '9' || *end)
+			{
+				showUsage();
+				free(g.zchar);
+				return EXIT_FAILURE;
+			}
+		}
+		else
+			break;
+	}
+	
+	if (argc - i != 3)
+	{
+		showUsage();
+		free(g.zchar);
+		return EXIT_FAILURE;
+	}
+	
+	/* profiles are only needed to resolve target names */
+	if (targetNames)
+	{
+		const char *s = targetNames;
+		
+		if (profile_loadDir(&profiles, profileDir, wow_stderr))
+			goto L_cleanup;
+		while (*s)
+		{
+			char name[64];
+			int len = strcspn(s, ",");
+			int k;
+			
+			snprintf(name, sizeof(name), "%.*s", len, s);
+			s += len + (s[len] == ',');
+			if (targetNum == sizeof(target) / sizeof(*target)
+				|| !(target[targetNum] = profile_find(&profiles, name))
+			)
+			{
+				wow_stderr("unknown or too many targets at '%s'\n", name);
+				goto L_cleanup;
+			}
+			for (k = 0; k < targetNum; ++k)
+				if (target[k] == target[targetNum])
+					break;
+			if (k < targetNum)
+			{
+				wow_stderr("target '%s' is listed twice\n", name);
+				goto L_cleanup;
+			}
+			if (target[targetNum++]->isDecomp && !decompNames)
+			{
+				wow_stderr("target '%s' needs -d\n", name);
+				goto L_cleanup;
+			}
+		}
+	}
+	
+	if (statsFn)
+		g.stats = &stats;
+	g.isDecompMode = decompNames != 0;
+	
+	if (z64font_loadFont(&g, argv[i])
+		|| z64font_loadCodepoints(&g, argv[i + 1])
+		|| (decompNames && z64font_loadDecompFileNames(&g, decompNames))
+		|| z64font_convert(&g)
+	)
+		goto L_cleanup;
+	
+	if (isWatch)
+	{
+		struct watch_options opt = {
+			.ttf = argv[i]
+			, .codepoints = argv[i + 1]
+			, .names = decompNames
+			, .out = argv[i + 2]
+			, .target = target
+			, .targetNum = targetNum
+			, .debounceMs = debounceMs
+		};
+		
+		watch_run(&g, &opt, stdout);
+		goto L_cleanup;
+	}
+	
+	if (targetNum)
+	{
+		if (z64font_exportTargets(&g, target, targetNum, argv[i + 2]))
+			goto L_cleanup;
+	}
+	else
+	{
+		int failed;
+		
+		ofn = strdup(argv[i + 2]);
+		if (g.isDecompMode)
+			failed = z64font_exportDecomp(&g, &ofn);
+		else
+			failed = z64font_exportBinaries(&g, &ofn);
+		free(ofn);
+		if (failed)
+			goto L_cleanup;
+	}
+	
+	if (statsFn)
+	{
+		FILE *fp = fopen(statsFn, "w");
+		
+		if (!fp || z64font_writeStatsJson(&stats, fp))
+		{
+			wow_stderr("failed to write '%s'\n", statsFn);
+			if (fp)
+				fclose(fp);
+			goto L_cleanup;
+		}
+		fclose(fp);
+	}
+	
+	rval = EXIT_SUCCESS;
+	if (reportFn)
+	{
+		FILE *fp = fopen(reportFn, "w");
+		int clipping = fp ? z64font_writeClipReport(&g, fp) : -1;
+		
+		if (fp)
+			fclose(fp);
+		if (clipping < 0)
+		{
+			wow_stderr("failed to write '%s'\n", reportFn);
+			rval = EXIT_FAILURE;
+		}
+		else if (clipping)
+			rval = 2;
+	}
+L_cleanup:
+	profile_free(&profiles);
+	z64font_free(&g);
+	return rval;
+}
+
+static int cmdBench(int argc, char **argv)
+{
+	struct bench_options opt = {
+		.sizes = { 12, 16, 24 }
+		, .sizesNum = 3
+		, .iterations = 10
+		, .outDir = "."
+	};
+	const char **codepoints = wow_calloc_die(argc + 2, sizeof(*codepoints));
+	int rval;
+	int i;
+	
+	for (i = 0; i < argc && argv[i][0] == '-'; ++i)
+	{
+		const char *arg = argv[i];
+		
+		if (i + 1 >= argc)
+			break;
+		
+		if (!strcmp(arg, "-n"))
+			opt.iterations = atoi(argv[++i]);
+		else if (!strcmp(arg, "-c"))
+			codepoints[opt.codepointsNum++] = argv[++i];
+		else if (!strcmp(arg, "-o"))
+			opt.outDir = argv[++i];
+		else if (!strcmp(arg, "-s"))
+		{
+			char *s = argv[++i];
+			
+			for (opt.sizesNum = 0; *s && opt.sizesNum < BENCH_SIZES_MAX; )
+			{
+				opt.sizes[opt.sizesNum++] = strtol(s, &s, 10);
+				if (*s == ',')
+					++s;
+			}
+		}
+		else
+			break;
+	}
+	
+	if (i >= argc)
+	{
+		showUsage();
+		free(codepoints);
+		return EXIT_FAILURE;
+	}
+	
+	if (!opt.codepointsNum)
+		opt.codepointsNum = defaultCodepoints(codepoints);
+	
+	opt.ttf = (const char**)argv + i;
+	opt.ttfNum = argc - i;
+	opt.codepoints = codepoints;
+	rval = bench_run(&opt, stdout);
+	free(codepoints);
+	
+	return rval ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int cmdGolden(int argc, char **argv)
+{
+	struct golden_options opt = { .outDir = "." };
+	const char **codepoints = wow_calloc_die(argc + 2, sizeof(*codepoints));
+	char *expect = 0;
+	int rval;
+	int i;
+	
+	for (i = 0; i < argc && argv[i][0] == '-'; ++i)
+	{
+		const char *arg = argv[i];
+		
+		if (i + 1 >= argc)
+			break;
+		
+		if (!strcmp(arg, "-c"))
+			codepoints[opt.codepointsNum++] = argv[++i];
+		else if (!strcmp(arg, "-o"))
+			opt.outDir = argv[++i];
+		else if (!strcmp(arg, "-g"))
+		{
+			if (!(expect = readText(argv[++i])))
+			{
+				wow_stderr("failed to read '%s'\n", argv[i]);
+				free(codepoints);
+				return EXIT_FAILURE;
+			}
+		}
+		else
+			break;
+	}
+	
+	if (i >= argc)
+	{
+		showUsage();
+		free(codepoints);
+		free(expect);
+		return EXIT_FAILURE;
+	}
+	
+	if (!opt.codepointsNum)
+		opt.codepointsNum = defaultCodepoints(codepoints);
+	
+	opt.ttf = (const char**)argv + i;
+	opt.ttfNum = argc - i;
+	opt.codepoints = codepoints;
+	opt.expect = expect;
+	rval = golden_run(&opt, stdout);
+	if (expect && rval > 0)
+		wow_stderr("%d combination(s) differ\n", rval);
+	free(codepoints);
+	free(expect);
+	
+	return rval ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int cmdBatch(int argc, char **argv)
+{
+	struct batch_options opt = { .profileDir = "profiles" };
+	int i;
+	
+	for (i = 0; i < argc && argv[i][0] == '-'; ++i)
+	{
+		const char *arg = argv[i];
+		
+		if (i + 1 >= argc)
+			break;
+		
+		if (!strcmp(arg, "-j"))
+			opt.threads = atoi(argv[++i]);
+		else if (!strcmp(arg, "-p"))
+			opt.profileDir = argv[++i];
+		else
+			break;
+	}
+	
+	if (argc - i != 1)
+	{
+		showUsage();
+		return EXIT_FAILURE;
+	}
+	
+	opt.manifest = argv[i];
+	return batch_run(&opt, stdout) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int cmdServe(int argc, char **argv)
+{
+	if (argc != 1)
+	{
+		showUsage();
+		return EXIT_FAILURE;
+	}
+	
+	return server_run(argv[0], stdout) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static int cmdFit(int argc, char **argv)
+{
+	struct z64font g = Z64FONT_DEFAULTS;
+	struct fit_candidate *cand;
+	int minSize = 4;
+	int maxSize = 32;
+	int tolerance = 0;
+	int threads = 0;
+	int best;
+	int i;
+	int k;
+	
+	for (i = 0; i < argc && argv[i][0] == '-'; ++i)
+	{
+		const char *arg = argv[i];
+		
+		if (i + 1 >= argc)
+			break;
+		
+		if (!strcmp(arg, "-t"))
+			tolerance = atoi(argv[++i]);
+		else if (!strcmp(arg, "-j"))
+			threads = atoi(argv[++i]);
+		else if (!strcmp(arg, "-r"))
+		{
+			if (sscanf(argv[++i], "%d-%d", &minSize, &maxSize) != 2
+				|| minSize < 1
+				|| maxSize < minSize
+			)
+			{
+				wow_stderr("bad size range '%s'\n", argv[i]);
+				z64font_free(&g);
+				return EXIT_FAILURE;
+			}
+		}
+		else
+			break;
+	}
+	
+	if (argc - i != 2)
+	{
+		showUsage();
+		z64font_free(&g);
+		return EXIT_FAILURE;
+	}
+	
+	if (z64font_loadFont(&g, argv[i]) || z64font_loadCodepoints(&g, argv[i + 1]))
+	{
+		z64font_free(&g);
+		return EXIT_FAILURE;
+	}
+	
+	cand = wow_calloc_die(maxSize - minSize + 1, sizeof(*cand));
+	best = fit_run(&g, minSize, maxSize, tolerance, threads, cand);
+	for (i = 0; i < maxSize - minSize + 1 && cand[i].fontSize; ++i)
+	{
+		fprintf(stdout, "size=%d yshift=%d clipped=%d"
+			, cand[i].fontSize
+			, cand[i].yshift
+			, cand[i].clippedNum
+		);
+		for (k = 0; k < cand[i].clippedNum; ++k)
+			fprintf(stdout, "%sU+%04X", k ? "," : " codepoints=", cand[i].clipped[k]);
+		fputc('\n', stdout);
+	}
+	if (best >= 0)
+		fprintf(stdout, "best size=%d yshift=%d\n", cand[best].fontSize, cand[best].yshift);
+	else
+		wow_stderr("no size fits within tolerance\n");
+	
+	fit_free(cand, maxSize - minSize + 1);
+	free(cand);
+	z64font_free(&g);
+	
+	return best >= 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int wow_main(argc, argv)
+{
+	wow_main_args(argc, argv);
+	
+	if (argc < 2)
+	{
+		showUsage();
+		return EXIT_FAILURE;
+	}
+	
+	if (!strcmp(argv[1], "convert"))
+		return cmdConvert(argc - 2, argv + 2, 0);
+	if (!strcmp(argv[1], "watch"))
+		return cmdConvert(argc - 2, argv + 2, 1);
+	if (!strcmp(argv[1], "bench"))
+		return cmdBench(argc - 2, argv + 2);
+	if (!strcmp(argv[1], "batch"))
+		return cmdBatch(argc - 2, argv + 2);
+	if (!strcmp(argv[1], "serve"))
+		return cmdServe(argc - 2, argv + 2);
+	if (!strcmp(argv[1], "fit"))
+		return cmdFit(argc - 2, argv + 2);
+	if (!strcmp(argv[1], "golden"))
+		return cmdGolden(argc - 2, argv + 2);
+	if (!strcmp(argv[1], "scan"))
+		return cmdScan(argc - 2, argv + 2);
+	
+	showUsage();
+	return EXIT_FAILURE;
+}
+#endif /* !Z64FONT_GUI */
+
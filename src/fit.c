@@ -0,0 +1,217 @@
+/* <z64.me> fontSize and yshift auto-fit solver */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <wow.h>
+
+#include "fit.h"
+
+#define  FIT_SHIFT_MAX FONT_H   /* yshifts tried either way */
+
+struct fitJob
+{
+	const stbtt_fontinfo *font;
+	const utf8_int32_t *codepoint; /* one per unique glyph */
+	const int *glyph;
+	int glyphNum;
+	int ascent;
+	int minSize;
+	struct fit_candidate *cand;
+	int candNum;
+	int next; /* next candidate to claim */
+	pthread_mutex_t lock;
+};
+
+/* the yshift clipping the fewest glyphs at one size; only ascenders and
+ * descenders count, as overhanging side bearings are the font's design
+ * and no size or yshift would fix them anyway; every glyph stays
+ * inside the cell for a range of yshifts, so those ranges are tallied
+ * with a difference array instead of testing each yshift separately
+ */
+static void fitSize(struct fitJob *job, struct fit_candidate *c)
+{
+	int inside[FIT_SHIFT_MAX * 2 + 2] = {0};
+	float scale = stbtt_ScaleForPixelHeight(job->font, c->fontSize);
+	int baseline = scale * job->ascent; /* as z64font_convertBegin() */
+	int best = 0;
+	int bestNum = -1;
+	int run = 0;
+	int i;
+	
+	for (i = 0; i < job->glyphNum; ++i)
+	{
+		int x0;
+		int y0;
+		int x1;
+		int y1;
+		int lo;
+		int hi;
+		
+		stbtt_GetGlyphBitmapBox(job->font, job->glyph[i], scale, scale, &x0, &y0, &x1, &y1);
+		
+		/* blank glyphs fit anywhere */
+		if (x1 <= x0 || y1 <= y0)
+			lo = -FIT_SHIFT_MAX, hi = FIT_SHIFT_MAX;
+		else
+		{
+			lo = -(baseline + y0);
+			hi = FONT_H - (baseline + y1);
+			if (lo < -FIT_SHIFT_MAX)
+				lo = -FIT_SHIFT_MAX;
+			if (hi > FIT_SHIFT_MAX)
+				hi = FIT_SHIFT_MAX;
+			if (lo > hi)
+				continue;
+		}
+		inside[lo + FIT_SHIFT_MAX] += 1;
+		inside[hi + FIT_SHIFT_MAX + 1] -= 1;
+	}
+	
+	/* most glyphs inside wins, and the smallest shift among those */
+	for (i = -FIT_SHIFT_MAX; i <= FIT_SHIFT_MAX; ++i)
+	{
+		run += inside[i + FIT_SHIFT_MAX];
+		if (run > bestNum || (run == bestNum && abs(i) < abs(best)))
+		{
+			bestNum = run;
+			best = i;
+		}
+	}
+	c->yshift = best;
+	c->clippedNum = job->glyphNum - bestNum;
+	
+	/* list the codepoints that don't fit at the chosen yshift */
+	c->clipped = wow_malloc_die((c->clippedNum + 1) * sizeof(*c->clipped));
+	c->clippedNum = 0;
+	for (i = 0; i < job->glyphNum; ++i)
+	{
+		int x0;
+		int y0;
+		int x1;
+		int y1;
+		
+		stbtt_GetGlyphBitmapBox(job->font, job->glyph[i], scale, scale, &x0, &y0, &x1, &y1);
+		if (x1 <= x0 || y1 <= y0)
+			continue;
+		if (baseline + y0 + best < 0 || baseline + y1 + best > FONT_H)
+			c->clipped[c->clippedNum++] = job->codepoint[i];
+	}
+}
+
+static void *fitThreadFunc(void *udata)
+{
+	struct fitJob *job = udata;
+	
+	while (1)
+	{
+		int idx;
+		
+		pthread_mutex_lock(&job->lock);
+		idx = job->next++;
+		pthread_mutex_unlock(&job->lock);
+		
+		if (idx >= job->candNum)
+			break;
+		
+		job->cand[idx].fontSize = job->minSize + idx;
+		fitSize(job, &job->cand[idx]);
+	}
+	
+	return 0;
+}
+
+int fit_run(
+	const struct z64font *g
+	, int minSize
+	, int maxSize
+	, int tolerance
+	, int threads
+	, struct fit_candidate *cand
+)
+{
+	struct fitJob job = {
+		.font = &g->font
+		, .minSize = minSize
+		, .cand = cand
+		, .candNum = maxSize - minSize + 1
+	};
+	struct zchar *zchar;
+	unsigned zcharNum;
+	utf8_int32_t *codepoint;
+	pthread_t *tid;
+	char *isSeen;
+	int *glyph;
+	int best = -1;
+	int i;
+	
+	if (!g->ttfBin || !g->chars || minSize < 1 || job.candNum < 1)
+		return -1;
+	
+	zchar = wow_calloc_die(ZCHAR_MAX, sizeof(*zchar));
+	if (zchar_parseCodepoints(g->chars, zchar, ZCHAR_MAX, &zcharNum))
+	{
+		free(zchar);
+		return -1;
+	}
+	
+	/* codepoints sharing a glyph are only measured once */
+	codepoint = wow_malloc_die(zcharNum * sizeof(*codepoint) + 1);
+	glyph = wow_malloc_die(zcharNum * sizeof(*glyph) + 1);
+	isSeen = wow_calloc_die(g->font.numGlyphs + 1, 1);
+	for (i = 0; i < (int)zcharNum; ++i)
+	{
+		int idx = stbtt_FindGlyphIndex(&g->font, zchar[i].codepoint);
+		
+		/* a malformed cmap may point past the last glyph */
+		if (idx < 0 || idx >= g->font.numGlyphs)
+			idx = 0;
+		if (isSeen[idx])
+			continue;
+		isSeen[idx] = 1;
+		codepoint[job.glyphNum] = zchar[i].codepoint;
+		glyph[job.glyphNum++] = idx;
+	}
+	job.codepoint = codepoint;
+	job.glyph = glyph;
+	stbtt_GetFontVMetrics(&g->font, &job.ascent, 0, 0);
+	
+	if (threads <= 0)
+		threads = z64font_threadCount();
+	if (threads > job.candNum)
+		threads = job.candNum;
+	
+	/* measuring is read-only, so threads share the fontinfo; this
+	 * thread claims candidates alongside the others
+	 */
+	pthread_mutex_init(&job.lock, 0);
+	tid = wow_calloc_die(threads, sizeof(*tid));
+	for (i = 0; i < threads - 1; ++i)
+		if (pthread_create(&tid[i], 0, fitThreadFunc, &job))
+			break;
+	fitThreadFunc(&job);
+	while (i--)
+		pthread_join(tid[i], 0);
+	pthread_mutex_destroy(&job.lock);
+	
+	for (i = 0; i < job.candNum; ++i)
+		if (cand[i].clippedNum <= tolerance)
+			best = i;
+	
+	free(tid);
+	free(isSeen);
+	free(glyph);
+	free(codepoint);
+	free(zchar);
+	return best;
+}
+
+void fit_free(struct fit_candidate *cand, int num)
+{
+	int i;
+	
+	for (i = 0; i < num; ++i)
+		free(cand[i].clipped);
+}
+
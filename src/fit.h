@@ -0,0 +1,35 @@
+/* <z64.me> fontSize and yshift auto-fit solver */
+
+#ifndef Z64_FIT_H_INCLUDED
+#define Z64_FIT_H_INCLUDED
+
+#include "z64font.h"
+
+/* one font size, at the yshift that clips the fewest glyphs */
+struct fit_candidate
+{
+	int fontSize;
+	int yshift;
+	int clippedNum;
+	utf8_int32_t *clipped; /* codepoints whose glyphs leave the cell */
+};
+
+/* tries every font size in [minSize, maxSize] using glyph bounding
+ * boxes alone, spread across up to 'threads' threads (0 = auto); 'cand'
+ * receives maxSize - minSize + 1 entries, to be released by fit_free();
+ * returns the index of the largest size clipping no more than
+ * 'tolerance' glyphs, or -1 if none do
+ */
+int fit_run(
+	const struct z64font *g
+	, int minSize
+	, int maxSize
+	, int tolerance
+	, int threads
+	, struct fit_candidate *cand
+);
+
+void fit_free(struct fit_candidate *cand, int num);
+
+#endif
+
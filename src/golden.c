@@ -0,0 +1,248 @@
+/* <z64.me> byte-exact output hashing, for catching regressions */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <wow.h>
+
+#include "z64font.h"
+#include "golden.h"
+
+/* the settings matrix every font and codepoint file is rendered with */
+static const int sizes[] = { 12, 16, 20 };
+static const int yshifts[] = { -2, 0, 3 };
+static const int xPads[] = { 0, 2 };
+#define  COUNTOF(X) (sizeof(X) / sizeof(*(X)))
+
+static void quiet(void *udata, const char *fmt, ...)
+{
+	(void)udata;
+	(void)fmt;
+}
+
+static const char *baseName(const char *fn)
+{
+	const char *slash = strrchr(fn, '/');
+	const char *bslash = strrchr(fn, '\\');
+	
+	if (bslash > slash)
+		slash = bslash;
+	return slash ? slash + 1 : fn;
+}
+
+/* FNV-1a 64 over a file's contents, continuing from 'h' */
+static int hashFile(const char *fn, uint64_t *h)
+{
+	FILE *fp = fopen(fn, "rb");
+	uint8_t buf[4096];
+	size_t n;
+	
+	if (!fp)
+		return -1;
+	
+	while ((n = fread(buf, 1, sizeof(buf), fp)))
+	{
+		size_t i;
+		
+		for (i = 0; i < n; ++i)
+			*h = (*h ^ buf[i]) * 1099511628211ull;
+	}
+	
+	n = ferror(fp);
+	fclose(fp);
+	return n ? -1 : 0;
+}
+
+static char *pathFor(const char *outDir, const char *name, int idx)
+{
+	char *fn = wow_malloc_die(strlen(outDir) + strlen(name) + 32);
+	
+	if (idx < 0)
+		sprintf(fn, "%s/%s", outDir, name);
+	else
+		sprintf(fn, "%s/%s_%04d.png", outDir, name, idx);
+	
+	return fn;
+}
+
+/* the line for one combination; 0 if anything failed to export */
+static int renderOne(struct z64font *g, const char *outDir, char *line, size_t lineSz)
+{
+	uint64_t h[4] = {
+		14695981039346656037ull
+		, 14695981039346656037ull
+		, 14695981039346656037ull
+		, 14695981039346656037ull
+	};
+	char *ofn;
+	int fail = 0;
+	unsigned i;
+	
+	if (z64font_convert(g))
+		return -1;
+	
+	/* binaries */
+	ofn = pathFor(outDir, "golden.bin", -1);
+	fail |= z64font_exportBinaries(g, &ofn) != 0;
+	fail |= wow_fnChangeExtension(&ofn, "font_static") || hashFile(ofn, &h[0]);
+	remove(ofn);
+	fail |= wow_fnChangeExtension(&ofn, "width_table") || hashFile(ofn, &h[1]);
+	remove(ofn);
+	free(ofn);
+	
+	/* decomp */
+	ofn = pathFor(outDir, "golden.font_width.h", -1);
+	fail |= z64font_exportDecomp(g, &ofn) != 0;
+	fail |= hashFile(ofn, &h[3]);
+	remove(ofn);
+	free(ofn);
+	for (i = 0; i < g->zcharNum; ++i)
+	{
+		ofn = pathFor(outDir, "golden", i);
+		fail |= hashFile(ofn, &h[2]);
+		remove(ofn);
+		free(ofn);
+	}
+	
+	if (fail)
+		return -1;
+	
+	snprintf(line, lineSz
+		, "font_static=%016llx width_table=%016llx png=%016llx width_h=%016llx"
+		, (unsigned long long)h[0]
+		, (unsigned long long)h[1]
+		, (unsigned long long)h[2]
+		, (unsigned long long)h[3]
+	);
+	
+	return 0;
+}
+
+/* the expected hashes for a combination, or 0 if there are none */
+static const char *findExpected(const char *expect, const char *key, int *len)
+{
+	const char *c;
+	size_t keyLen = strlen(key);
+	
+	for (c = expect; c && *c; )
+	{
+		const char *eol = strchr(c, '\n');
+		
+		if (!strncmp(c, key, keyLen) && c[keyLen] == ' ')
+		{
+			c += keyLen + 1;
+			*len = eol ? eol - c : (int)strlen(c);
+			if (*len && c[*len - 1] == '\r')
+				*len -= 1;
+			return c;
+		}
+		c = eol ? eol + 1 : 0;
+	}
+	
+	return 0;
+}
+
+static int compare(const char *expect, const char *key, const char *hashes)
+{
+	const char *want;
+	int len;
+	
+	if (!(want = findExpected(expect, key, &len)))
+	{
+		wow_stderr("missing: %s\n", key);
+		return 1;
+	}
+	
+	if (len != (int)strlen(hashes) || memcmp(want, hashes, len))
+	{
+		wow_stderr("mismatch: %s\n  expected %.*s\n  got      %s\n"
+			, key, len, want, hashes
+		);
+		return 1;
+	}
+	
+	return 0;
+}
+
+int golden_run(const struct golden_options *opt, FILE *out)
+{
+	char *names;
+	char *c;
+	int mismatches = 0;
+	int f;
+	int i;
+	
+	/* decomp png names for every slot */
+	names = c = wow_malloc_die((strlen(opt->outDir) + 32) * ZCHAR_MAX + 1);
+	for (i = 0; i < ZCHAR_MAX; ++i)
+		c += sprintf(c, "%s/golden_%04d.png\n", opt->outDir, i);
+	
+	for (f = 0; f < opt->ttfNum && mismatches >= 0; ++f)
+	{
+		struct z64font g = {
+			.zchar = wow_calloc_die(ZCHAR_MAX, sizeof(struct zchar))
+			, .decompFileNames = names
+			, .info = quiet
+			, .error = z64font_stderr
+		};
+		
+		if (z64font_loadFont(&g, opt->ttf[f]))
+			mismatches = -1;
+		
+		for (i = 0; i < opt->codepointsNum && mismatches >= 0; ++i)
+		{
+			unsigned combo;
+			
+			if (z64font_loadCodepoints(&g, opt->codepoints[i]))
+			{
+				mismatches = -1;
+				break;
+			}
+			
+			for (combo = 0; combo < COUNTOF(sizes) * COUNTOF(yshifts) * COUNTOF(xPads) * 4; ++combo)
+			{
+				unsigned k = combo;
+				char key[256];
+				char hashes[128];
+				
+				g.rightToLeft = k & 1, k >>= 1;
+				g.widthAdvance = k & 1, k >>= 1;
+				g.xPad = xPads[k % COUNTOF(xPads)], k /= COUNTOF(xPads);
+				g.yshift = yshifts[k % COUNTOF(yshifts)], k /= COUNTOF(yshifts);
+				g.fontSize = sizes[k];
+				
+				snprintf(key, sizeof(key)
+					, "font=%s codepoints=%s size=%d yshift=%d xpad=%d advance=%d rtl=%d"
+					, baseName(opt->ttf[f])
+					, baseName(opt->codepoints[i])
+					, g.fontSize
+					, g.yshift
+					, g.xPad
+					, g.widthAdvance
+					, g.rightToLeft
+				);
+				
+				if (renderOne(&g, opt->outDir, hashes, sizeof(hashes)))
+				{
+					wow_stderr("failed to render %s\n", key);
+					mismatches = -1;
+					break;
+				}
+				
+				if (opt->expect)
+					mismatches += compare(opt->expect, key, hashes);
+				else
+					fprintf(out, "%s %s\n", key, hashes);
+			}
+		}
+		
+		/* the decomp names are shared by every font */
+		g.decompFileNames = 0;
+		z64font_free(&g);
+	}
+	
+	free(names);
+	return mismatches;
+}
+
@@ -0,0 +1,27 @@
+/* <z64.me> byte-exact output hashing, for catching regressions */
+
+#ifndef Z64_GOLDEN_H_INCLUDED
+#define Z64_GOLDEN_H_INCLUDED
+
+#include <stdio.h>
+
+struct golden_options
+{
+	const char **ttf;        /* fonts to render */
+	int ttfNum;
+	const char **codepoints; /* codepoint files to render */
+	int codepointsNum;
+	const char *outDir;      /* scratch space for exported files */
+	const char *expect;      /* contents of a previous run, or 0 */
+};
+
+/* renders every font x codepoint file x setting combination, printing
+ * one line per combination holding hashes of font_static, width_table,
+ * the decomp pngs and font_width.h; when opt->expect is set, lines that
+ * differ from it are reported on stderr instead; returns the number of
+ * mismatches, or -1 on failure
+ */
+int golden_run(const struct golden_options *opt, FILE *out);
+
+#endif
+
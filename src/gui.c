@@ -1,44 +1,79 @@
 /* <z64.me> z64font's gui code lives here */
 
 #ifdef Z64FONT_GUI
+#define WOW_IMPLEMENTATION
 #include <wow.h>
 #define WOW_GUI_IMPLEMENTATION
 #include <wow_gui.h>
 
 #include "z64font.h"
+#include "fit.h"
 
 #include <errno.h>
+#include <stdarg.h>
+#include <pthread.h>
 
 #define  WINW 440
 #define  WINH 440
 #define  PREVIEW_X (16)      /* window coordinates at which    */
-#define  PREVIEW_Y (128+24)  /* to display text preview        */
+#define  PREVIEW_Y (128+52)  /* to display text preview        */
+#define  WORKER_CHUNK 64     /* glyphs converted between checks */
+#define  WORKER_AHEAD 2      /* sizes pre-rendered either way   */
+
+/* a glyph placed in the preview by the layout pass */
+struct placed
+{
+	int x;
+	int y;
+	const unsigned char *bitmap;
+	uint32_t hash; /* of bitmap contents, which change between bakes */
+};
+
+/* preview compositor; keeps the previous layout around so that each
+ * bake only redraws the glyphs whose bitmap or position changed
+ */
+struct compositor
+{
+	unsigned char *canvas; /* i8 */
+	unsigned char *rgba;   /* canvas expanded for blitting */
+	int w;
+	int h;
+	struct placed *placed; /* layout the canvas currently shows */
+	struct placed *next;   /* layout being baked */
+	int placedNum;
+	int nextNum;
+	int placedMax;
+	int dirtyY0; /* rows changed by the last bake */
+	int dirtyY1;
+};
 
 static void i8_to_rgba32(
 	unsigned char *dst
-	, unsigned char *src
-	, int w
-	, int h
+	, const unsigned char *src
+	, int num
 )
 {
-	unsigned char *dstOld = dst;
-	dst += (w * h * 4) - 4;
-	src += (w * h) - 1;
+	uint32_t *dst32 = (uint32_t*)dst;
+	int i;
 	
-	while (dst > dstOld)
-	{
-		dst[0] = dst[1] = dst[2] = dst[3] = *src;
-		src -= 1;
-		dst -= 4;
-	}
+	/* splat each byte across all four channels; vectorizes nicely */
+	for (i = 0; i < num; ++i)
+		dst32[i] = src[i] * 0x01010101u;
 }
 
-static void bake(
-	struct z64font *g
-	, unsigned char *dst
-	, int dstW
-	, int dstH
-)
+static uint32_t hashGlyph(const unsigned char *bitmap)
+{
+	uint32_t h = 2166136261u;
+	int i;
+	
+	for (i = 0; i < FONT_W * FONT_H; ++i)
+		h = (h ^ bitmap[i]) * 16777619u;
+	
+	return h;
+}
+
+/* position each glyph of the sample string */
+static void layout(struct z64font *g, struct compositor *c)
 {
 	char *next;
 	char *w;
@@ -46,16 +81,16 @@ static void bake(
 	int x = 0;
 	int y = 0;
 	int yadv = FONT_H;
-	memset(dst, 0, dstW * dstH);
+	int dstW = c->w;
 	struct zchar *zchar = g->zchar;
 	char *str = g->chars;
 	
+	c->nextNum = 0;
+	
 	for (next = 0, w = str; *w; w = next)
 	{
 		const struct zchar *z;
-		unsigned char *bmp;
-		int k;
-		int i;
+		struct placed *p;
 		
 		next = utf8codepoint(w, &codepoint);
 		
@@ -75,14 +110,15 @@ static void bake(
 		}
 		
 		/* find matching codepoint */
-		if (!(z = zchar_findCodepoint(zchar, codepoint)))
+		/* (glyphs a lazy conversion hasn't reached yet are skipped) */
+		if (!(z = zchar_findCodepoint(zchar, g->zcharNum, codepoint))
+			|| !z->bitmap
+		)
 			continue;
 		
 		if (g->rightToLeft && x <= 0)
 			x = dstW;
 		
-		bmp = z->bitmap;
-		
 		if (g->rightToLeft)
 		{
 			x -= z->width;
@@ -93,17 +129,21 @@ static void bake(
 			}
 		}
 		
-		/* blend character bitmap into preview */
-		for (k = 0; k < FONT_H; ++k)
+		/* nothing below the preview can ever be seen */
+		if (y >= c->h)
+			break;
+		
+		if (c->nextNum == c->placedMax)
 		{
-			for (i = 0; i < FONT_W; ++i)
-			{
-				int dstIdx = (dstW * (y + k)) + x + i;
-				if (dstIdx < 0 || dstIdx >= dstW * dstH)
-					continue;
-				dst[dstIdx] |= bmp[FONT_W * k + i];
-			}
+			c->placedMax = c->placedMax ? c->placedMax * 2 : 256;
+			c->placed = wow_realloc_die(c->placed, c->placedMax * sizeof(*p));
+			c->next = wow_realloc_die(c->next, c->placedMax * sizeof(*p));
 		}
+		p = c->next + c->nextNum++;
+		p->x = x;
+		p->y = y;
+		p->bitmap = z->bitmap;
+		p->hash = hashGlyph(z->bitmap);
 		
 		if (!g->rightToLeft)
 		{
@@ -116,21 +156,443 @@ static void bake(
 			}
 		}
 	}
+}
+
+/* glyph rectangle clipped to the canvas; returns 0 if fully outside */
+static int clipGlyph(
+	const struct compositor *c
+	, const struct placed *p
+	, int *x0
+	, int *y0
+	, int *x1
+	, int *y1
+)
+{
+	*x0 = p->x < 0 ? 0 : p->x;
+	*y0 = p->y < 0 ? 0 : p->y;
+	*x1 = p->x + FONT_W > c->w ? c->w : p->x + FONT_W;
+	*y1 = p->y + FONT_H > c->h ? c->h : p->y + FONT_H;
+	
+	return *x0 < *x1 && *y0 < *y1;
+}
+
+/* blend character bitmap into canvas, one clipped row span at a time */
+static void blendGlyph(struct compositor *c, const struct placed *p)
+{
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+	int k;
+	
+	if (!clipGlyph(c, p, &x0, &y0, &x1, &y1))
+		return;
+	
+	for (k = y0; k < y1; ++k)
+	{
+		unsigned char *dst = c->canvas + c->w * k + x0;
+		const unsigned char *src = p->bitmap + FONT_W * (k - p->y) + x0 - p->x;
+		int i;
+		
+		for (i = 0; i < x1 - x0; ++i)
+			dst[i] |= src[i];
+	}
+}
+
+static int placedDiffers(const struct placed *a, const struct placed *b)
+{
+	return a->x != b->x || a->y != b->y || a->hash != b->hash;
+}
+
+static void bake(struct z64font *g, struct compositor *c)
+{
+	struct placed *tmp;
+	int dirtyNum = 0;
+	int (*dirty)[4];
+	int num;
+	int i;
+	
+	layout(g, c);
+	
+	/* erase where changed glyphs were, and where they're going */
+	num = c->nextNum > c->placedNum ? c->nextNum : c->placedNum;
+	dirty = wow_malloc_die((num * 2 + 1) * sizeof(*dirty));
+	c->dirtyY0 = c->h;
+	c->dirtyY1 = 0;
+	for (i = 0; i < num; ++i)
+	{
+		const struct placed *prev = i < c->placedNum ? c->placed + i : 0;
+		const struct placed *cur = i < c->nextNum ? c->next + i : 0;
+		const struct placed *both[2] = { prev, cur };
+		int k;
+		
+		if (prev && cur && !placedDiffers(prev, cur))
+			continue;
+		
+		for (k = 0; k < 2; ++k)
+		{
+			int *r;
+			int y;
+			
+			if (!both[k])
+				continue;
+			
+			r = dirty[dirtyNum];
+			if (!clipGlyph(c, both[k], &r[0], &r[1], &r[2], &r[3]))
+				continue;
+			++dirtyNum;
+			
+			for (y = r[1]; y < r[3]; ++y)
+				memset(c->canvas + c->w * y + r[0], 0, r[2] - r[0]);
+			if (r[1] < c->dirtyY0)
+				c->dirtyY0 = r[1];
+			if (r[3] > c->dirtyY1)
+				c->dirtyY1 = r[3];
+		}
+	}
+	
+	/* redraw every glyph touching an erased area; blending is an OR,
+	 * so redrawing pixels that were left intact changes nothing
+	 */
+	for (i = 0; dirtyNum && i < c->nextNum; ++i)
+	{
+		const struct placed *p = c->next + i;
+		int x0;
+		int y0;
+		int x1;
+		int y1;
+		int k;
+		
+		if (!clipGlyph(c, p, &x0, &y0, &x1, &y1))
+			continue;
+		
+		for (k = 0; k < dirtyNum; ++k)
+		{
+			int *r = dirty[k];
+			
+			if (x0 < r[2] && r[0] < x1 && y0 < r[3] && r[1] < y1)
+			{
+				blendGlyph(c, p);
+				break;
+			}
+		}
+	}
+	
+	if (c->dirtyY0 < c->dirtyY1)
+		i8_to_rgba32(
+			c->rgba + c->w * c->dirtyY0 * 4
+			, c->canvas + c->w * c->dirtyY0
+			, c->w * (c->dirtyY1 - c->dirtyY0)
+		);
+	
+	tmp = c->placed;
+	c->placed = c->next;
+	c->next = tmp;
+	c->placedNum = c->nextNum;
+	
+	free(dirty);
+}
+
+/* conversion runs on a worker thread so the ui never stalls; the ui
+ * posts requests (latest wins) and shows the last published preview;
+ * the glyphs in the sample string are converted and published first,
+ * and the rest of the charset is filled in afterwards; once idle, the
+ * neighbouring font sizes are rasterized ahead of time so scrolling
+ * through sizes hits the raster cache
+ */
+static struct worker
+{
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	struct z64font g;       /* worker-owned conversion state */
+	struct z64font request; /* snapshot of latest ui settings */
+	unsigned requested;     /* generation of latest request */
+	unsigned started;       /* generation worker has picked up */
+	unsigned published;     /* generation of published preview */
+	unsigned complete;      /* generation with every glyph converted */
+	unsigned inputs;        /* bumped whenever font/txt is reloaded */
+	unsigned adopted;       /* inputs the worker's state matches */
+	unsigned char *preview; /* published preview (rgba32) */
+	struct compositor comp; /* preview being baked */
+	struct z64font_stats stats; /* accumulated for current request */
+	struct z64font_stats shown; /* snapshot published with preview */
+	double bakeTime;
+	int busy;
+	int cancel;
+	int quit;
+	int failed;
+} worker;
+
+/* take the ui's settings and (borrowed) loaded files */
+static void workerAdopt(struct z64font *dst, const struct z64font *src)
+{
+	dst->ttfBin = src->ttfBin;
+	dst->ttfBinSz = src->ttfBinSz;
+	dst->chars = src->chars;
+	dst->decompFileNames = src->decompFileNames;
+	dst->font = src->font;
+	dst->fontSize = src->fontSize;
+	dst->yshift = src->yshift;
+	dst->xPad = src->xPad;
+	dst->rightToLeft = src->rightToLeft;
+	dst->widthAdvance = src->widthAdvance;
+	dst->oversample = src->oversample;
+	dst->isSdf = src->isSdf;
+	dst->weight = src->weight;
+	dst->isDecompMode = src->isDecompMode;
+}
+
+static void *workerFunc(void *udata)
+{
+	struct worker *w = udata;
+	
+	pthread_mutex_lock(&w->lock);
+	while (1)
+	{
+		struct compositor *c = &w->comp;
+		double bakeTime = 0;
+		unsigned gen;
+		int failed;
+		
+		while (!w->quit && w->started == w->requested)
+			pthread_cond_wait(&w->cond, &w->lock);
+		if (w->quit)
+			break;
+		
+		gen = w->started = w->requested;
+		workerAdopt(&w->g, &w->request);
+		if (w->adopted != w->inputs)
+		{
+			w->g.isResolved = 0;
+			w->adopted = w->inputs;
+		}
+		w->busy = 1;
+		pthread_mutex_unlock(&w->lock);
+		
+		/* (re)convert sample string's glyphs and bake new preview */
+		memset(&w->stats, 0, sizeof(w->stats));
+		if (!(failed = z64font_convertBegin(&w->g)))
+		{
+			double t;
+			
+			z64font_convertCodepoints(&w->g, w->g.chars);
+			t = z64font_seconds();
+			bake(&w->g, c);
+			bakeTime = z64font_seconds() - t;
+		}
 		
-	i8_to_rgba32(dst, dst, dstW, dstH);
+		pthread_mutex_lock(&w->lock);
+		if (failed)
+			w->failed = 1;
+		else
+		{
+			/* publish atomically, copying only rows that changed */
+			if (c->dirtyY0 < c->dirtyY1)
+				memcpy(
+					w->preview + c->w * c->dirtyY0 * 4
+					, c->rgba + c->w * c->dirtyY0 * 4
+					, c->w * (c->dirtyY1 - c->dirtyY0) * 4
+				);
+			w->published = gen;
+			w->shown = w->stats;
+			w->bakeTime = bakeTime;
+		}
+		pthread_cond_broadcast(&w->cond);
+		
+		/* fill in the rest unless a newer request supersedes it */
+		while (!failed && !w->quit && !w->cancel && w->requested == gen)
+		{
+			int left;
+			
+			pthread_mutex_unlock(&w->lock);
+			left = z64font_convertNext(&w->g, WORKER_CHUNK);
+			pthread_mutex_lock(&w->lock);
+			
+			if (left < 0)
+			{
+				failed = w->failed = 1;
+				break;
+			}
+			if (!left)
+			{
+				w->complete = gen;
+				w->shown = w->stats;
+				break;
+			}
+		}
+		
+		/* speculate on the sizes the user is likely to scroll to */
+		if (w->complete == gen)
+		{
+			int i;
+			
+			for (i = 1; i <= WORKER_AHEAD * 2; ++i)
+			{
+				int size = w->g.fontSize + ((i & 1) ? 1 : -1) * ((i + 1) / 2);
+				
+				while (!w->quit && !w->cancel && w->requested == gen)
+				{
+					int left;
+					
+					pthread_mutex_unlock(&w->lock);
+					left = z64font_rasterizeNext(&w->g, size, WORKER_CHUNK);
+					pthread_mutex_lock(&w->lock);
+					
+					if (!left)
+						break;
+				}
+			}
+		}
+		w->busy = 0;
+		pthread_cond_broadcast(&w->cond);
+	}
+	pthread_mutex_unlock(&w->lock);
+	
+	return 0;
+}
+
+static void workerStart(int previewW, int previewH)
+{
+	struct z64font g = Z64FONT_DEFAULTS;
+	
+	/* the ui shows g.lastError if the worker fails */
+	g.info = 0;
+	g.error = 0;
+	g.stats = &worker.stats;
+	worker.g = g;
+	worker.preview = wow_calloc_die(previewW * previewH, 4);
+	worker.comp.w = previewW;
+	worker.comp.h = previewH;
+	worker.comp.canvas = wow_calloc_die(previewW * previewH, 1);
+	worker.comp.rgba = wow_calloc_die(previewW * previewH, 4);
+	pthread_mutex_init(&worker.lock, 0);
+	pthread_cond_init(&worker.cond, 0);
+	if (pthread_create(&worker.thread, 0, workerFunc, &worker))
+		wowGui_dief("failed to start conversion thread");
+}
+
+static void workerStop(void)
+{
+	pthread_mutex_lock(&worker.lock);
+	worker.quit = 1;
+	pthread_cond_broadcast(&worker.cond);
+	pthread_mutex_unlock(&worker.lock);
+	pthread_join(worker.thread, 0);
+	
+	/* the loaded files are borrowed from the ui */
+	worker.g.ttfBin = 0;
+	worker.g.chars = 0;
+	worker.g.decompFileNames = 0;
+	z64font_free(&worker.g);
+	free(worker.preview);
+	free(worker.comp.canvas);
+	free(worker.comp.rgba);
+	free(worker.comp.placed);
+	free(worker.comp.next);
+}
+
+/* post new settings; supersedes any request not yet picked up */
+static void workerPost(const struct z64font *g)
+{
+	pthread_mutex_lock(&worker.lock);
+	worker.request = *g;
+	worker.requested += 1;
+	pthread_cond_broadcast(&worker.cond);
+	pthread_mutex_unlock(&worker.lock);
+}
+
+/* drop pending work and wait until the worker no longer borrows the
+ * ui's loaded files, so they can be safely freed and reloaded
+ */
+static void workerRelease(void)
+{
+	pthread_mutex_lock(&worker.lock);
+	worker.requested = worker.started;
+	worker.cancel = 1;
+	while (worker.busy)
+		pthread_cond_wait(&worker.cond, &worker.lock);
+	worker.cancel = 0;
+	worker.inputs += 1;
+	pthread_mutex_unlock(&worker.lock);
+}
+
+/* wait until the latest request has been fully converted, then stop
+ * any speculative rasterization and wait for the worker to go idle, so
+ * the ui may use worker.g until it posts another request; returns
+ * non-zero if there is no usable result to export
+ */
+static int workerSync(void)
+{
+	int rval;
+	
+	pthread_mutex_lock(&worker.lock);
+	while (!worker.failed
+		&& worker.complete != worker.requested
+		&& (worker.busy || worker.started != worker.requested)
+	)
+		pthread_cond_wait(&worker.cond, &worker.lock);
+	rval = worker.failed || worker.complete != worker.requested;
+	worker.cancel = 1;
+	while (worker.busy)
+		pthread_cond_wait(&worker.cond, &worker.lock);
+	worker.cancel = 0;
+	pthread_mutex_unlock(&worker.lock);
+	
+	return rval;
+}
+
+/* the core's messages, shown in dialogs */
+static void guiMessage(int isError, const char *fmt, va_list ap)
+{
+	char msg[1024];
+	size_t len;
+	
+	/* messages are written for a terminal; dialogs don't want the newline */
+	vsnprintf(msg, sizeof(msg), fmt, ap);
+	len = strlen(msg);
+	while (len && msg[len - 1] == '\n')
+		msg[--len] = '\0';
+	if (isError)
+		wowGui_errorf("%s", msg);
+	else
+		wowGui_infof("%s", msg);
+}
+
+static void guiInfo(void *udata, const char *fmt, ...)
+{
+	va_list ap;
+	
+	(void)udata;
+	va_start(ap, fmt);
+	guiMessage(0, fmt, ap);
+	va_end(ap);
+}
+
+static void guiError(void *udata, const char *fmt, ...)
+{
+	va_list ap;
+	
+	(void)udata;
+	va_start(ap, fmt);
+	guiMessage(1, fmt, ap);
+	va_end(ap);
 }
 
 int wow_main(argc, argv)
 {
 	wow_main_args(argc, argv);
-	unsigned char *preview = 0;
 	int previewW = WINW - (PREVIEW_X * 2);
 	int previewH = WINH - (PREVIEW_Y + 16);
-	struct z64font g = Z64FONT_DEFAULTS;
-	g.info = wowGui_infof;
-	g.error = wowGui_errorf;
+	int showTimings = 0;
+	double blitTime = 0;
+	struct z64font g = { .fontSize = 16, .oversample = 1 };
+	struct z64font_stats loadStats = {0};
+	g.info = guiInfo;
+	g.error = guiError;
+	g.stats = &loadStats;
 	
-	preview = wow_malloc_die(previewW * previewH * 4);
+	workerStart(previewW, previewH);
 	
 	wowGui_bind_init(PROGNAME, WINW, WINH);
 	
@@ -139,13 +601,19 @@ int wow_main(argc, argv)
 	while (1)
 	{
 		int changed = 0;
+		int pending;
 		/* wowGui_frame() must be called before you do any input */
 		wowGui_frame();
 		
 		/* events */
 		wowGui_bind_events();
 		
-		if (!wowGui_bind_should_redraw())
+		/* keep redrawing until the worker catches up */
+		pthread_mutex_lock(&worker.lock);
+		pending = worker.published != worker.requested && !worker.failed;
+		pthread_mutex_unlock(&worker.lock);
+		
+		if (!wowGui_bind_should_redraw() && !pending)
 			goto skipRedraw;
 		
 		/* draw */
@@ -185,6 +653,7 @@ int wow_main(argc, argv)
 			};
 			if (wowGui_fileDropper(&ttfFile))
 			{
+				workerRelease();
 				if (z64font_loadFont(&g, ttfFile.filename))
 				{
 					free(ttfFile.filename);
@@ -200,6 +669,7 @@ int wow_main(argc, argv)
 			};
 			if (wowGui_fileDropper(&txtFile))
 			{
+				workerRelease();
 				if (z64font_loadCodepoints(&g, txtFile.filename))
 				{
 					free(txtFile.filename);
@@ -218,6 +688,7 @@ int wow_main(argc, argv)
 			{
 				if (wowGui_fileDropper(&decompFileNamesFile))
 				{
+					workerRelease();
 					if (z64font_loadDecompFileNames(&g, decompFileNamesFile.filename))
 					{
 						free(decompFileNamesFile.filename);
@@ -248,6 +719,15 @@ int wow_main(argc, argv)
 				wowGui_column_width(128+8);
 				wowGui_checkbox("rightToLeft", &g.rightToLeft);
 				wowGui_checkbox("widthAdvance", &g.widthAdvance);
+				wowGui_checkbox("timings", &showTimings);
+				
+				wowGui_columns(5);
+				wowGui_column_width(64);
+				wowGui_label("Samples");
+				wowGui_int_range(&g.oversample, 1, Z64FONT_OVERSAMPLE_MAX, 1);
+				wowGui_label("Weight");
+				wowGui_int_range(&g.weight, -Z64FONT_WEIGHT_MAX, Z64FONT_WEIGHT_MAX, 1);
+				wowGui_checkbox("sdf", &g.isSdf);
 				
 				if (memcmp(x, &g, ok))
 					changed = 1;
@@ -262,53 +742,136 @@ int wow_main(argc, argv)
 			
 			if (wowGui_button(g.isDecompMode ? "Export Decomp" : "Export Binaries"))
 			{
-				if (previewOn)
+				if (previewOn && !workerSync())
 				{
-					char *ofn = 0;
-
-					if (g.isDecompMode)
-					{
-						ofn = wowGui_askFilename("font_width.h", 0, 1);
-						if (ofn)
-						{
-							z64font_exportDecomp(&g, &ofn);
-							free(ofn);
-						}
-					}
-					else
+					char *ofn = wowGui_askFilename(
+						g.isDecompMode ? "font_width.h" : "font_static", 0, 1
+					);
+					
+					/* worker.g reports nothing itself, see workerStart() */
+					if (ofn)
 					{
-						ofn = wowGui_askFilename("font_static", 0, 1);
-						if (ofn)
-						{
-							z64font_exportBinaries(&g, &ofn);
-							free(ofn);
-						}
+						int failed = g.isDecompMode
+							? z64font_exportDecomp(&worker.g, &ofn)
+							: z64font_exportBinaries(&worker.g, &ofn);
+						
+						free(ofn);
+						if (failed)
+							wowGui_errorf("%s", worker.g.lastError);
+						else
+							wowGui_infof("Export successful!");
 					}
 				}
 			}
 			
+			if (wowGui_button("Save Stats") && previewOn && !workerSync())
+			{
+				char *ofn = wowGui_askFilename("json", 0, 1);
+				
+				if (ofn)
+				{
+					/* workerSync() parked the worker and no request is posted
+					 * while the dialog is up, so the stats can't change under us
+					 */
+					struct z64font_stats st = worker.stats;
+					FILE *fp = fopen(ofn, "w");
+					
+					st.wall[Z64FONT_STAGE_LOAD] += loadStats.wall[Z64FONT_STAGE_LOAD];
+					st.cpu[Z64FONT_STAGE_LOAD] += loadStats.cpu[Z64FONT_STAGE_LOAD];
+					st.allocations += loadStats.allocations;
+					st.memPeak += g.memCurrent; /* files the ui holds */
+					if (!fp || z64font_writeStatsJson(&st, fp))
+						wowGui_errorf("failed to write '%s'", ofn);
+					if (fp)
+						fclose(fp);
+					free(ofn);
+				}
+			}
+			
+			/* largest size that clips nothing, without rasterizing */
+			if (wowGui_button("Auto Fit") && previewOn)
+			{
+				struct fit_candidate cand[64] = {0};
+				int best = fit_run(&g, 1, 64, 0, 0, cand);
+				
+				if (best < 0)
+					wowGui_errorf("no size fits the cell without clipping");
+				else
+				{
+					g.fontSize = cand[best].fontSize;
+					g.yshift = cand[best].yshift;
+					changed = 1;
+				}
+				fit_free(cand, 64);
+			}
+			
 			/* display preview */
 			if (previewOn)
 			{
 				/* update preview */
 				if (changed)
+					workerPost(&g);
+				
+				pthread_mutex_lock(&worker.lock);
+				if (worker.failed)
 				{
-					/* (re)convert font */
-					if (z64font_convert(&g))
-						wowGui_dief("something went wrong");
-					
-					/* bake new preview */
-					bake(&g, preview, previewW, previewH);
+					wowGui_errorf("%s", worker.g.lastError);
+					wowGui_dief("something went wrong");
 				}
-				wowGui_label("preview:");
-				wowGui_bind_blit_raw(
-					preview
-					, PREVIEW_X
-					, PREVIEW_Y
-					, previewW
-					, previewH
-					, 0 /* no blending */
+				wowGui_label(
+					worker.published != worker.requested
+						? "preview: (updating)"
+						: "preview:"
 				);
+				if (worker.published)
+				{
+					double t = z64font_seconds();
+					
+					wowGui_bind_blit_raw(
+						worker.preview
+						, PREVIEW_X
+						, PREVIEW_Y
+						, previewW
+						, previewH
+						, 0 /* no blending */
+					);
+					blitTime = z64font_seconds() - t;
+				}
+				
+				/* stage timings overlaid onto the preview */
+				if (showTimings)
+				{
+					static char line[3][128];
+					const struct z64font_stats *st = &worker.shown;
+					unsigned lookups = st->rasterHits + st->rasterMisses;
+					
+					snprintf(line[0], sizeof(line[0])
+						, "parse %.2fms  raster %.2fms  compose %.2fms"
+						, st->wall[Z64FONT_STAGE_PARSE] * 1000
+						, st->wall[Z64FONT_STAGE_RASTERIZE] * 1000
+						, st->wall[Z64FONT_STAGE_COMPOSE] * 1000
+					);
+					snprintf(line[1], sizeof(line[1])
+						, "width %.2fms  bake %.2fms  blit %.2fms"
+						, st->wall[Z64FONT_STAGE_WIDTH] * 1000
+						, worker.bakeTime * 1000
+						, blitTime * 1000
+					);
+					snprintf(line[2], sizeof(line[2])
+						, "%u glyphs  %u%% raster hits  %u%% shared  %.1fMiB peak"
+						, st->glyphs
+						, lookups ? st->rasterHits * 100 / lookups : 0
+						, st->glyphs ? st->shared * 100 / st->glyphs : 0
+						, (st->memPeak + g.memCurrent + previewW * previewH * 9 /* previews */)
+							/ 1048576.0
+					);
+					wowGui_columns(1);
+					wowGui_column_width(WINW - PREVIEW_X * 2);
+					wowGui_label(line[0]);
+					wowGui_label(line[1]);
+					wowGui_label(line[2]);
+				}
+				pthread_mutex_unlock(&worker.lock);
 			}
 			
 			wowGui_column_width(100);
@@ -328,7 +891,7 @@ int wow_main(argc, argv)
 			break;
 	}
 	
-	free(g.zchar);
+	workerStop();
 	
 	wowGui_bind_quit();
 	
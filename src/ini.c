@@ -0,0 +1,132 @@
+/* <z64.me> minimal ini reader */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <wow.h>
+
+#include "ini.h"
+
+#define  INI_LINE_MAX 1024
+
+/* trims whitespace from both ends of a string, in place */
+static char *trim(char *s)
+{
+	char *end;
+	
+	while (isspace((unsigned char)*s))
+		++s;
+	end = s + strlen(s);
+	while (end > s && isspace((unsigned char)end[-1]))
+		--end;
+	*end = '\0';
+	
+	return s;
+}
+
+/* cuts a line off where its comment starts; ';' and '#' only start one
+ * at the beginning of a line or after whitespace, so that values such
+ * as out/#1/font.bin are kept whole
+ */
+static void stripComment(char *s)
+{
+	char *c;
+	
+	for (c = s; *c; ++c)
+	{
+		if ((*c == ';' || *c == '#')
+			&& (c == s || isspace((unsigned char)c[-1]))
+		)
+		{
+			*c = '\0';
+			break;
+		}
+	}
+}
+
+int ini_parse(const char *text, ini_func *func, void *udata)
+{
+	char section[INI_LINE_MAX] = "";
+	int lineNum = 0;
+	
+	while (*text)
+	{
+		char line[INI_LINE_MAX];
+		size_t len = strcspn(text, "\n");
+		char *s;
+		char *eq;
+		int rval;
+		
+		++lineNum;
+		if (len >= sizeof(line))
+			return lineNum;
+		memcpy(line, text, len);
+		line[len] = '\0';
+		text += len + (text[len] == '\n');
+		
+		stripComment(line);
+		s = trim(line);
+		if (!*s)
+			continue;
+		
+		if (*s == '[')
+		{
+			char *close = strchr(s, ']');
+			
+			if (!close || close[1])
+				return lineNum;
+			*close = '\0';
+			snprintf(section, sizeof(section), "%s", trim(s + 1));
+			continue;
+		}
+		
+		if (!(eq = strchr(s, '=')))
+			return lineNum;
+		*eq = '\0';
+		if ((rval = func(udata, section, trim(s), trim(eq + 1), lineNum)))
+			return rval;
+	}
+	
+	return 0;
+}
+
+int ini_parseFile(
+	const char *fn
+	, ini_func *func
+	, void *udata
+	, void (*error)(const char *fmt, ...)
+)
+{
+	FILE *fp = fopen(fn, "rb");
+	char *text;
+	long sz;
+	int rval;
+	
+	if (!fp)
+	{
+		error("failed to open '%s'\n", fn);
+		return -1;
+	}
+	fseek(fp, 0, SEEK_END);
+	sz = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	text = wow_malloc_die(sz + 1);
+	if (fread(text, 1, sz, fp) != (size_t)sz)
+	{
+		error("failed to read '%s'\n", fn);
+		fclose(fp);
+		free(text);
+		return -1;
+	}
+	text[sz] = '\0';
+	fclose(fp);
+	
+	rval = ini_parse(text, func, udata);
+	if (rval > 0)
+		error("%s:%d: malformed line\n", fn, rval);
+	free(text);
+	
+	return rval;
+}
+
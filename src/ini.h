@@ -0,0 +1,35 @@
+/* <z64.me> minimal ini reader */
+
+#ifndef Z64_INI_H_INCLUDED
+#define Z64_INI_H_INCLUDED
+
+/* called once per 'key = value' line; 'section' is "" before the first
+ * [section] header; leading and trailing whitespace is trimmed, and a
+ * ';' or '#' at the start of a line or after whitespace begins a comment;
+ * returning non-zero stops parsing and is passed back by ini_parse()
+ */
+typedef int ini_func(
+	void *udata
+	, const char *section
+	, const char *key
+	, const char *value
+	, int line
+);
+
+/* parses a nul-terminated ini document; returns 0, the first non-zero
+ * value returned by 'func', or the line number of a malformed line
+ */
+int ini_parse(const char *text, ini_func *func, void *udata);
+
+/* reads and parses an ini file, reporting unreadable files and
+ * malformed lines through 'error'; returns non-zero on fail
+ */
+int ini_parseFile(
+	const char *fn
+	, ini_func *func
+	, void *udata
+	, void (*error)(const char *fmt, ...)
+);
+
+#endif
+
@@ -0,0 +1,298 @@
+/* <z64.me> game profiles: how and where each game keeps its font */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <wow.h>
+
+#include "profile.h"
+#include "ini.h"
+
+/* a profile as parsed, before being compacted */
+struct profileDraft
+{
+	char name[64];
+	struct z64font_target t;
+	float icon[PROFILE_ICON_MAX];
+	int keyNum;
+};
+
+struct profileLoad
+{
+	struct profileDraft *draft;
+	int draftNum;
+	int draftMax;
+	const char *fn;
+	void (*error)(const char *fmt, ...);
+};
+
+static int compareString(const void *a, const void *b)
+{
+	return strcmp(*(char * const*)a, *(char * const*)b);
+}
+
+static int compareDraft(const void *a, const void *b)
+{
+	return strcmp(((const struct profileDraft*)a)->name, ((const struct profileDraft*)b)->name);
+}
+
+static struct profileDraft *findDraft(struct profileLoad *l, const char *name)
+{
+	int i;
+	
+	for (i = 0; i < l->draftNum; ++i)
+		if (!strcmp(l->draft[i].name, name))
+			return &l->draft[i];
+	
+	return 0;
+}
+
+/* parses a whole unsigned number, in any base strtoul() accepts */
+static int parseNumber(const char *s, unsigned long *v)
+{
+	char *end;
+	
+	*v = strtoul(s, &end, 0);
+	return end == s || *end;
+}
+
+static int onKey(
+	void *udata
+	, const char *section
+	, const char *key
+	, const char *value
+	, int line
+)
+{
+	struct profileLoad *l = udata;
+	struct profileDraft *d = l->draftNum ? &l->draft[l->draftNum - 1] : 0;
+	struct z64font_target *t;
+	unsigned long v;
+	
+	if (!*section)
+	{
+		l->error("%s:%d: '%s' is outside of any [profile]\n", l->fn, line, key);
+		return -1;
+	}
+	
+	/* keys belong to the latest section, so a new name starts a profile */
+	if (!d || strcmp(d->name, section))
+	{
+		if (findDraft(l, section))
+		{
+			l->error("%s:%d: profile '%s' is defined twice\n", l->fn, line, section);
+			return -1;
+		}
+		if (l->draftNum == l->draftMax)
+		{
+			l->draftMax = l->draftMax ? l->draftMax * 2 : 16;
+			l->draft = wow_realloc_die(l->draft, l->draftMax * sizeof(*l->draft));
+		}
+		d = &l->draft[l->draftNum++];
+		memset(d, 0, sizeof(*d));
+		snprintf(d->name, sizeof(d->name), "%s", section);
+		d->t.slots = ZCHAR_MAX;
+		d->t.cellW = FONT_W;
+		d->t.cellH = FONT_H;
+	}
+	t = &d->t;
+	
+	if (!strcmp(key, "like"))
+	{
+		const struct profileDraft *src = findDraft(l, value);
+		
+		if (d->keyNum || !src || src == d)
+		{
+			l->error("%s:%d: 'like' must come first and name an earlier profile\n"
+				, l->fn, line
+			);
+			return -1;
+		}
+		*t = src->t;
+		memcpy(d->icon, src->icon, sizeof(d->icon));
+	}
+	else if (!strcmp(key, "decomp") && !parseNumber(value, &v) && v <= 1)
+		t->isDecomp = v;
+	else if (!strcmp(key, "slots") && !parseNumber(value, &v) && v > 0 && v <= ZCHAR_MAX)
+		t->slots = v;
+	else if (!strcmp(key, "cell"))
+	{
+		char x;
+		char trailing;
+		
+		if (sscanf(value, "%d %c %d %c", &t->cellW, &x, &t->cellH, &trailing) != 3
+			|| (x != 'x' && x != 'X') || t->cellW <= 0 || t->cellH <= 0
+		)
+			goto L_bad;
+	}
+	else if (!strcmp(key, "endian"))
+	{
+		if (!strcmp(value, "big"))
+			t->isLittleEndian = 0;
+		else if (!strcmp(value, "little"))
+			t->isLittleEndian = 1;
+		else
+			goto L_bad;
+	}
+	else if (!strcmp(key, "font_static") && !parseNumber(value, &v))
+		t->fontStatic = v;
+	else if (!strcmp(key, "width_table"))
+	{
+		char a[32];
+		char b[32] = "0";
+		
+		if (sscanf(value, "%31[^, ] , %31s", a, b) < 1
+			|| parseNumber(a, &v)
+		)
+			goto L_bad;
+		t->widthTable[0] = v;
+		if (parseNumber(b, &v))
+			goto L_bad;
+		t->widthTable[1] = v;
+	}
+	else if (!strcmp(key, "icon"))
+	{
+		char *end;
+		
+		if (t->iconNum == PROFILE_ICON_MAX)
+		{
+			l->error("%s:%d: more than %d icons\n", l->fn, line, PROFILE_ICON_MAX);
+			return -1;
+		}
+		d->icon[t->iconNum] = strtof(value, &end);
+		if (end == value || *end)
+			goto L_bad;
+		t->iconNum += 1;
+	}
+	else
+		goto L_bad;
+	
+	d->keyNum += 1;
+	return 0;
+L_bad:
+	l->error("%s:%d: bad or unknown setting '%s = %s'\n", l->fn, line, key, value);
+	return -1;
+}
+
+/* packs the drafts, their icon widths and names into one allocation */
+static void compact(struct profile_table *t, struct profileLoad *l)
+{
+	size_t iconNum = 0;
+	size_t nameSz = 0;
+	float *icon;
+	char *name;
+	int i;
+	
+	qsort(l->draft, l->draftNum, sizeof(*l->draft), compareDraft);
+	for (i = 0; i < l->draftNum; ++i)
+	{
+		iconNum += l->draft[i].t.iconNum;
+		nameSz += strlen(l->draft[i].name) + 1;
+	}
+	
+	t->targetNum = l->draftNum;
+	t->target = wow_malloc_die(
+		l->draftNum * sizeof(*t->target)
+		+ iconNum * sizeof(*icon)
+		+ nameSz
+	);
+	icon = (float*)(t->target + l->draftNum);
+	name = (char*)(icon + iconNum);
+	
+	for (i = 0; i < l->draftNum; ++i)
+	{
+		struct profileDraft *d = &l->draft[i];
+		
+		t->target[i] = d->t;
+		t->target[i].name = strcpy(name, d->name);
+		t->target[i].iconWidth = icon;
+		memcpy(icon, d->icon, d->t.iconNum * sizeof(*icon));
+		name += strlen(name) + 1;
+		icon += d->t.iconNum;
+	}
+}
+
+int profile_loadDir(
+	struct profile_table *t
+	, const char *dir
+	, void (*error)(const char *fmt, ...)
+)
+{
+	struct profileLoad l = { .error = error };
+	DIR *d = opendir(dir);
+	struct dirent *ent;
+	char **fn = 0;
+	int fnNum = 0;
+	int rval = -1;
+	int i;
+	
+	memset(t, 0, sizeof(*t));
+	if (!d)
+	{
+		error("failed to open profile directory '%s'\n", dir);
+		return -1;
+	}
+	
+	/* sorted, so profiles may be 'like' those in earlier files */
+	while ((ent = readdir(d)))
+	{
+		size_t len = strlen(ent->d_name);
+		
+		if (len < 5 || strcmp(ent->d_name + len - 4, ".ini"))
+			continue;
+		fn = wow_realloc_die(fn, (fnNum + 1) * sizeof(*fn));
+		fn[fnNum] = wow_malloc_die(strlen(dir) + len + 2);
+		sprintf(fn[fnNum++], "%s/%s", dir, ent->d_name);
+	}
+	closedir(d);
+	qsort(fn, fnNum, sizeof(*fn), compareString);
+	
+	for (i = 0; i < fnNum; ++i)
+	{
+		l.fn = fn[i];
+		if (ini_parseFile(fn[i], onKey, &l, error))
+			goto L_cleanup;
+	}
+	
+	compact(t, &l);
+	rval = 0;
+L_cleanup:
+	for (i = 0; i < fnNum; ++i)
+		free(fn[i]);
+	free(fn);
+	free(l.draft);
+	return rval;
+}
+
+const struct z64font_target *profile_find(
+	const struct profile_table *t
+	, const char *name
+)
+{
+	int lo = 0;
+	int hi = t->targetNum;
+	
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		int cmp = strcmp(name, t->target[mid].name);
+		
+		if (!cmp)
+			return &t->target[mid];
+		if (cmp < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	
+	return 0;
+}
+
+void profile_free(struct profile_table *t)
+{
+	free(t->target);
+	t->target = 0;
+	t->targetNum = 0;
+}
+
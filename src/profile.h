@@ -0,0 +1,34 @@
+/* <z64.me> game profiles: how and where each game keeps its font */
+
+#ifndef Z64_PROFILE_H_INCLUDED
+#define Z64_PROFILE_H_INCLUDED
+
+#include "z64font.h"
+
+#define  PROFILE_ICON_MAX 64 /* icon slots a profile may list */
+
+/* every profile loaded, compacted into a single allocation */
+struct profile_table
+{
+	struct z64font_target *target; /* sorted by name */
+	int targetNum;
+};
+
+/* reads every '.ini' file in 'dir'; each [section] describes one target
+ * (see profiles/oot.ini for the keys); returns non-zero on fail
+ */
+int profile_loadDir(
+	struct profile_table *t
+	, const char *dir
+	, void (*error)(const char *fmt, ...)
+);
+
+const struct z64font_target *profile_find(
+	const struct profile_table *t
+	, const char *name
+);
+
+void profile_free(struct profile_table *t);
+
+#endif
+
@@ -0,0 +1,339 @@
+/* <z64.me> message dump codepoint scanner */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <wow.h>
+
+#include "z64font.h"
+#include "scan.h"
+
+#define  SCAN_CHUNK (1 << 20)   /* bytes read from a dump at a time */
+#define  SCAN_SAMPLE 32         /* codepoints in generated sample line */
+
+struct scanJob
+{
+	const char **fn;
+	int fnNum;
+	int next; /* next file index to claim */
+	int failed;
+	pthread_mutex_t lock;
+	void (*error)(const char *fmt, ...);
+};
+
+struct scanThread
+{
+	struct scanJob *job;
+	uint64_t *count;
+};
+
+/* one used codepoint, for sorting by frequency */
+struct scanUse
+{
+	uint64_t count;
+	utf8_int32_t codepoint;
+};
+
+/* counts codepoints in one file; decoding state is carried across
+ * chunk boundaries so multibyte sequences may straddle reads
+ */
+static int scanFile(const char *fn, uint64_t *count, uint8_t *buf)
+{
+	FILE *fp = fopen(fn, "rb");
+	utf8_int32_t cp = 0;
+	int need = 0;
+	size_t n;
+	
+	if (!fp)
+		return -1;
+	
+	while ((n = fread(buf, 1, SCAN_CHUNK, fp)))
+	{
+		const uint8_t *s;
+		
+		for (s = buf; s < buf + n; ++s)
+		{
+			uint8_t c = *s;
+			
+			if (need && (c & 0xc0) == 0x80)
+			{
+				cp = (cp << 6) | (c & 0x3f);
+				if (--need)
+					continue;
+			}
+			else if (c < 0x80)
+				cp = c, need = 0;
+			else if ((c & 0xe0) == 0xc0)
+			{
+				cp = c & 0x1f, need = 1;
+				continue;
+			}
+			else if ((c & 0xf0) == 0xe0)
+			{
+				cp = c & 0x0f, need = 2;
+				continue;
+			}
+			else if ((c & 0xf8) == 0xf0)
+			{
+				cp = c & 0x07, need = 3;
+				continue;
+			}
+			else /* stray continuation or invalid lead byte */
+			{
+				need = 0;
+				continue;
+			}
+			
+			/* line breaks and control codes never occupy a slot */
+			if (cp >= 0x20 && cp < SCAN_CODEPOINT_MAX)
+				count[cp] += 1;
+		}
+	}
+	
+	n = ferror(fp);
+	fclose(fp);
+	return n ? -1 : 0;
+}
+
+static void *scanThreadFunc(void *udata)
+{
+	struct scanThread *t = udata;
+	struct scanJob *job = t->job;
+	uint8_t *buf = malloc(SCAN_CHUNK);
+	
+	if (!buf)
+	{
+		pthread_mutex_lock(&job->lock);
+		job->failed = 1;
+		pthread_mutex_unlock(&job->lock);
+		return 0;
+	}
+	
+	while (1)
+	{
+		int idx;
+		
+		pthread_mutex_lock(&job->lock);
+		idx = job->failed ? job->fnNum : job->next++;
+		pthread_mutex_unlock(&job->lock);
+		
+		if (idx >= job->fnNum)
+			break;
+		
+		if (scanFile(job->fn[idx], t->count, buf))
+		{
+			pthread_mutex_lock(&job->lock);
+			job->error("failed to read '%s'", job->fn[idx]);
+			job->failed = 1;
+			pthread_mutex_unlock(&job->lock);
+		}
+	}
+	
+	free(buf);
+	return 0;
+}
+
+/* appends 'cp' as a UTF-8 line */
+static int writeCodepoint(FILE *fp, utf8_int32_t cp, const char *end)
+{
+	char c[5] = {0};
+	
+	if (cp < 0x80)
+		c[0] = cp;
+	else if (cp < 0x800)
+	{
+		c[0] = 0xc0 | (cp >> 6);
+		c[1] = 0x80 | (cp & 0x3f);
+	}
+	else if (cp < 0x10000)
+	{
+		c[0] = 0xe0 | (cp >> 12);
+		c[1] = 0x80 | ((cp >> 6) & 0x3f);
+		c[2] = 0x80 | (cp & 0x3f);
+	}
+	else
+	{
+		c[0] = 0xf0 | (cp >> 18);
+		c[1] = 0x80 | ((cp >> 12) & 0x3f);
+		c[2] = 0x80 | ((cp >> 6) & 0x3f);
+		c[3] = 0x80 | (cp & 0x3f);
+	}
+	
+	return fprintf(fp, "%s%s", c, end) < 0;
+}
+
+/* most frequent first, lower codepoint breaks ties */
+static int compareFrequency(const void *a_, const void *b_)
+{
+	const struct scanUse *a = a_;
+	const struct scanUse *b = b_;
+	
+	if (a->count != b->count)
+		return a->count < b->count ? 1 : -1;
+	return a->codepoint - b->codepoint;
+}
+
+int scan_files(
+	const char **fn
+	, int fnNum
+	, int threads
+	, uint64_t *count
+	, void (*error)(const char *fmt, ...)
+)
+{
+	struct scanJob job = {
+		.fn = fn
+		, .fnNum = fnNum
+		, .error = error
+	};
+	struct scanThread *t;
+	pthread_t *tid;
+	int i;
+	
+	if (threads <= 0)
+		threads = z64font_threadCount();
+	if (threads > fnNum)
+		threads = fnNum;
+	
+	memset(count, 0, SCAN_CODEPOINT_MAX * sizeof(*count));
+	if (!threads)
+		return 0;
+	
+	pthread_mutex_init(&job.lock, 0);
+	t = wow_calloc_die(threads, sizeof(*t));
+	tid = wow_calloc_die(threads, sizeof(*tid));
+	
+	/* each thread tallies privately; merged once at the end */
+	for (i = 0; i < threads; ++i)
+	{
+		t[i].job = &job;
+		t[i].count = wow_calloc_die(SCAN_CODEPOINT_MAX, sizeof(*t[i].count));
+		if (pthread_create(&tid[i], 0, scanThreadFunc, &t[i]))
+		{
+			/* fall back to scanning on this thread */
+			scanThreadFunc(&t[i]);
+			t[i].job = 0;
+		}
+	}
+	
+	for (i = 0; i < threads; ++i)
+	{
+		int k;
+		
+		if (t[i].job)
+			pthread_join(tid[i], 0);
+		
+		for (k = 0; k < SCAN_CODEPOINT_MAX; ++k)
+			count[k] += t[i].count[k];
+		
+		free(t[i].count);
+	}
+	
+	free(t);
+	free(tid);
+	pthread_mutex_destroy(&job.lock);
+	
+	return job.failed ? -1 : 0;
+}
+
+int scan_writeCodepoints(
+	FILE *fp
+	, const uint64_t *count
+	, const char *slotMap
+	, void (*info)(const char *fmt, ...)
+)
+{
+	struct scanUse *order;
+	utf8_int32_t cp;
+	char *mapped = 0;
+	int orderNum = 0;
+	int unused = 0;
+	int i;
+	
+	order = wow_malloc_die(SCAN_CODEPOINT_MAX * sizeof(*order));
+	
+	for (cp = 0; cp < SCAN_CODEPOINT_MAX; ++cp)
+	{
+		if (!count[cp])
+			continue;
+		order[orderNum].count = count[cp];
+		order[orderNum++].codepoint = cp;
+	}
+	
+	qsort(order, orderNum, sizeof(*order), compareFrequency);
+	
+	/* sample line: reuse the slot map's, or show off the top codepoints */
+	if (slotMap)
+	{
+		const char *eol = strchr(slotMap, '\n');
+		int len = eol ? eol - slotMap : (int)strlen(slotMap);
+		
+		if (len && slotMap[len - 1] == '\r')
+			--len;
+		if (fprintf(fp, "%.*s\n", len, slotMap) < 0)
+			goto L_fail;
+	}
+	else
+	{
+		for (i = 0; i < orderNum && i < SCAN_SAMPLE; ++i)
+			if (writeCodepoint(fp, order[i].codepoint, ""))
+				goto L_fail;
+		if (fputc('\n', fp) == EOF)
+			goto L_fail;
+	}
+	
+	/* fixed slots keep their positions so existing text still encodes */
+	if (slotMap)
+	{
+		const char *w = utf8chr(slotMap, '\n');
+		
+		mapped = wow_calloc_die(SCAN_CODEPOINT_MAX, 1);
+		
+		for (w = w ? w + 1 : ""; *w; )
+		{
+			if (*w == 0x0d || *w == 0x0a)
+			{
+				++w;
+				continue;
+			}
+			
+			w = utf8codepoint(w, &cp);
+			if (cp < 0 || cp >= SCAN_CODEPOINT_MAX)
+				continue;
+			
+			if (writeCodepoint(fp, cp, "\n"))
+				goto L_fail;
+			
+			mapped[cp] = 1;
+			if (!count[cp])
+				++unused;
+		}
+	}
+	
+	for (i = 0; i < orderNum; ++i)
+	{
+		if (mapped && mapped[order[i].codepoint])
+			continue;
+		
+		if (writeCodepoint(fp, order[i].codepoint, "\n"))
+			goto L_fail;
+	}
+	
+	if (info)
+	{
+		info("%d codepoints in use\n", orderNum);
+		if (mapped)
+			info("%d fixed slots are never used\n", unused);
+	}
+	
+	free(mapped);
+	free(order);
+	return 0;
+
+L_fail:
+	free(mapped);
+	free(order);
+	return -1;
+}
+
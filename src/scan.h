@@ -0,0 +1,36 @@
+/* <z64.me> message dump codepoint scanner */
+
+#ifndef Z64_SCAN_H_INCLUDED
+#define Z64_SCAN_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define  SCAN_CODEPOINT_MAX 0x110000
+
+/* counts codepoint usage across UTF-8 text dumps, one streaming pass
+ * per file, files spread across up to 'threads' threads (0 = auto);
+ * 'count' receives SCAN_CODEPOINT_MAX entries; returns non-zero on fail
+ */
+int scan_files(
+	const char **fn
+	, int fnNum
+	, int threads
+	, uint64_t *count
+	, void (*error)(const char *fmt, ...)
+);
+
+/* writes a codepoint file for every used codepoint; when 'slotMap'
+ * (contents of an existing codepoint file) is provided, its slots are
+ * kept in order and unmapped codepoints are appended; otherwise they
+ * are written by descending frequency; returns non-zero on fail
+ */
+int scan_writeCodepoints(
+	FILE *fp
+	, const uint64_t *count
+	, const char *slotMap
+	, void (*info)(const char *fmt, ...)
+);
+
+#endif
+
@@ -0,0 +1,949 @@
+/* <z64.me> local socket render server for editors and tools */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <wow.h>
+
+#include "z64font.h"
+#include "server.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define  SERVER_CANVAS_MAX (16 << 20) /* most bytes one render may return */
+
+/* one request; strings point into the request line they were parsed from */
+struct serverRequest
+{
+	const char *op;
+	const char *font;
+	const char *codepoints;
+	const char *text;
+	int fontSize;
+	int yshift;
+	int xPad;
+	int widthAdvance;
+	int oversample;
+	int isSdf;
+	int weight;
+	int rightToLeft;
+	int wrap; /* render: lines break before passing this many pixels; 0 = never */
+};
+
+/* a font and codepoint file pair, kept loaded along with its glyphs */
+struct serverSession
+{
+	char *font;
+	char *codepoints;
+	struct stat fontStat; /* as loaded, to notice when the file changes */
+	struct stat codepointsStat;
+	struct z64font g;
+	struct serverRequest params; /* what g's glyphs were converted with */
+	int isConverted;
+	unsigned lastUse;
+};
+
+struct serverClient
+{
+	int fd;
+	char *buf; /* bytes received that don't end a line yet */
+	size_t len;
+	size_t max;
+};
+
+struct serverGlyph
+{
+	int x;   /* cell position, left to right */
+	int y;
+	int end; /* where the pen was left */
+	const uint8_t *bitmap;
+};
+
+struct server
+{
+	struct serverSession session[SERVER_SESSION_MAX];
+	int sessionNum;
+	unsigned useCount;
+	struct serverClient client[SERVER_CLIENT_MAX];
+	int clientNum;
+	char *reply;
+	size_t replyLen;
+	size_t replyMax;
+	struct serverGlyph *glyph;
+	int glyphMax;
+	char error[256]; /* why the request being handled failed */
+};
+
+static volatile sig_atomic_t isInterrupted;
+
+static void onSignal(int sig)
+{
+	(void)sig;
+	isInterrupted = 1;
+}
+
+static void fail(struct server *s, const char *fmt, ...)
+{
+	va_list ap;
+	
+	va_start(ap, fmt);
+	vsnprintf(s->error, sizeof(s->error), fmt, ap);
+	va_end(ap);
+}
+
+static void replyf(struct server *s, const char *fmt, ...)
+{
+	va_list ap;
+	int len;
+	
+	va_start(ap, fmt);
+	len = vsnprintf(0, 0, fmt, ap);
+	va_end(ap);
+	
+	if (s->replyLen + len + 1 > s->replyMax)
+	{
+		s->replyMax = (s->replyLen + len + 1) * 2;
+		s->reply = wow_realloc_die(s->reply, s->replyMax);
+	}
+	
+	va_start(ap, fmt);
+	vsnprintf(s->reply + s->replyLen, len + 1, fmt, ap);
+	va_end(ap);
+	s->replyLen += len;
+}
+
+/* appends 's' as a json string */
+static void replyString(struct server *s, const char *str)
+{
+	replyf(s, "\"");
+	for (; *str; ++str)
+	{
+		unsigned char c = *str;
+		
+		if (c == '"' || c == '\\')
+			replyf(s, "\\%c", c);
+		else if (c < 0x20)
+			replyf(s, "\\u%04x", c);
+		else
+			replyf(s, "%c", c);
+	}
+	replyf(s, "\"");
+}
+
+static char *skipSpace(char *s)
+{
+	while (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n')
+		++s;
+	
+	return s;
+}
+
+static int parseHex4(const char *s, unsigned long *v)
+{
+	int i;
+	
+	for (*v = 0, i = 0; i < 4; ++i)
+	{
+		int c = s[i];
+		
+		if (c >= '0' && c <= '9')
+			c -= '0';
+		else if (c >= 'a' && c <= 'f')
+			c -= 'a' - 10;
+		else if (c >= 'A' && c <= 'F')
+			c -= 'A' - 10;
+		else
+			return -1;
+		*v = *v * 16 + c;
+	}
+	
+	return 0;
+}
+
+static char *putUtf8(char *dst, unsigned long cp)
+{
+	if (cp < 0x80)
+		*dst++ = cp;
+	else if (cp < 0x800)
+	{
+		*dst++ = 0xc0 | (cp >> 6);
+		*dst++ = 0x80 | (cp & 0x3f);
+	}
+	else if (cp < 0x10000)
+	{
+		*dst++ = 0xe0 | (cp >> 12);
+		*dst++ = 0x80 | ((cp >> 6) & 0x3f);
+		*dst++ = 0x80 | (cp & 0x3f);
+	}
+	else
+	{
+		*dst++ = 0xf0 | (cp >> 18);
+		*dst++ = 0x80 | ((cp >> 12) & 0x3f);
+		*dst++ = 0x80 | ((cp >> 6) & 0x3f);
+		*dst++ = 0x80 | (cp & 0x3f);
+	}
+	
+	return dst;
+}
+
+/* decodes the json string following the opening quote at 's' in place,
+ * which it never lengthens; returns where parsing resumes, or 0
+ */
+static char *parseString(char *s, const char **out)
+{
+	char *dst = s;
+	
+	*out = s;
+	while (*s != '"')
+	{
+		unsigned long cp;
+		unsigned long lo;
+		
+		if (!*s)
+			return 0;
+		if (*s != '\\')
+		{
+			*dst++ = *s++;
+			continue;
+		}
+		
+		switch (s[1])
+		{
+			case '"': case '\\': case '/': *dst++ = s[1]; break;
+			case 'b': *dst++ = '\b'; break;
+			case 'f': *dst++ = '\f'; break;
+			case 'n': *dst++ = '\n'; break;
+			case 'r': *dst++ = '\r'; break;
+			case 't': *dst++ = '\t'; break;
+			case 'u':
+				if (parseHex4(s + 2, &cp))
+					return 0;
+				
+				/* codepoints past the bmp come as surrogate pairs */
+				if (cp >= 0xd800 && cp < 0xdc00
+					&& s[6] == '\\' && s[7] == 'u'
+					&& !parseHex4(s + 8, &lo)
+					&& lo >= 0xdc00 && lo < 0xe000
+				)
+				{
+					cp = 0x10000 + ((cp - 0xd800) << 10) + (lo - 0xdc00);
+					s += 6;
+				}
+				dst = putUtf8(dst, cp);
+				s += 4;
+				break;
+			default:
+				return 0;
+		}
+		s += 2;
+	}
+	*dst = '\0';
+	
+	return s + 1;
+}
+
+static int setString(struct serverRequest *req, const char *key, const char *value)
+{
+	if (!strcmp(key, "op"))
+		req->op = value;
+	else if (!strcmp(key, "font"))
+		req->font = value;
+	else if (!strcmp(key, "codepoints"))
+		req->codepoints = value;
+	else if (!strcmp(key, "text"))
+		req->text = value;
+	else
+		return -1;
+	
+	return 0;
+}
+
+static int setNumber(struct serverRequest *req, const char *key, double value)
+{
+	int v;
+	
+	/* whole numbers only */
+	if (value < -(1 << 20) || value > (1 << 20) || (v = value) != value)
+		return -1;
+	
+	if (!strcmp(key, "size") && v >= 1 && v <= 256)
+		req->fontSize = v;
+	else if (!strcmp(key, "yshift"))
+		req->yshift = v;
+	else if (!strcmp(key, "xpad"))
+		req->xPad = v;
+	else if (!strcmp(key, "advance"))
+		req->widthAdvance = v;
+	else if (!strcmp(key, "oversample") && v >= 0 && v <= Z64FONT_OVERSAMPLE_MAX)
+		req->oversample = v;
+	else if (!strcmp(key, "sdf"))
+		req->isSdf = v;
+	else if (!strcmp(key, "weight") && v >= -Z64FONT_WEIGHT_MAX && v <= Z64FONT_WEIGHT_MAX)
+		req->weight = v;
+	else if (!strcmp(key, "rtl"))
+		req->rightToLeft = v;
+	else if (!strcmp(key, "wrap") && v >= 0)
+		req->wrap = v;
+	else
+		return -1;
+	
+	return 0;
+}
+
+/* parses a flat json object whose values are strings, numbers or
+ * booleans; strings are decoded in place
+ */
+static int parseRequest(struct server *srv, char *s, struct serverRequest *req)
+{
+	memset(req, 0, sizeof(*req));
+	req->fontSize = 16;
+	
+	s = skipSpace(s);
+	if (*s != '{')
+		goto L_malformed;
+	s = skipSpace(s + 1);
+	
+	while (*s != '}')
+	{
+		const char *key;
+		const char *str;
+		char *end;
+		double v;
+		int rval;
+		
+		if (*s != '"' || !(s = parseString(s + 1, &key)))
+			goto L_malformed;
+		s = skipSpace(s);
+		if (*s != ':')
+			goto L_malformed;
+		s = skipSpace(s + 1);
+		
+		if (*s == '"')
+		{
+			if (!(s = parseString(s + 1, &str)))
+				goto L_malformed;
+			rval = setString(req, key, str);
+		}
+		else if (!strncmp(s, "true", 4) || !strncmp(s, "false", 5))
+		{
+			rval = setNumber(req, key, *s == 't');
+			s += *s == 't' ? 4 : 5;
+		}
+		else if (!strncmp(s, "null", 4))
+		{
+			rval = 0;
+			s += 4;
+		}
+		else
+		{
+			v = strtod(s, &end);
+			if (end == s)
+				goto L_malformed;
+			rval = setNumber(req, key, v);
+			s = end;
+		}
+		if (rval)
+		{
+			fail(srv, "bad or unknown value for '%s'", key);
+			return -1;
+		}
+		
+		s = skipSpace(s);
+		if (*s == ',')
+			s = skipSpace(s + 1);
+		else if (*s != '}')
+			goto L_malformed;
+	}
+	
+	if (*skipSpace(s + 1))
+		goto L_malformed;
+	return 0;
+L_malformed:
+	fail(srv, "request is not a flat json object");
+	return -1;
+}
+
+static int sameFile(const struct stat *a, const struct stat *b)
+{
+	return a->st_ino == b->st_ino
+		&& a->st_dev == b->st_dev
+		&& a->st_size == b->st_size
+#ifdef __linux__
+		&& a->st_mtim.tv_nsec == b->st_mtim.tv_nsec
+#endif
+		&& a->st_mtime == b->st_mtime
+	;
+}
+
+static void freeSession(struct serverSession *ses)
+{
+	z64font_free(&ses->g);
+	free(ses->font);
+	free(ses->codepoints);
+}
+
+static void dropSession(struct server *s, struct serverSession *ses)
+{
+	freeSession(ses);
+	*ses = s->session[--s->sessionNum];
+}
+
+/* finds or loads the request's font and codepoints, reloading either
+ * if it changed on disk since
+ */
+static struct serverSession *getSession(struct server *s, const struct serverRequest *req)
+{
+	struct serverSession *ses = 0;
+	struct stat fontStat;
+	struct stat codepointsStat;
+	int i;
+	
+	if (!req->font || !req->codepoints)
+	{
+		fail(s, "'font' and 'codepoints' are required");
+		return 0;
+	}
+	if (stat(req->font, &fontStat))
+	{
+		fail(s, "failed to open '%s'", req->font);
+		return 0;
+	}
+	if (stat(req->codepoints, &codepointsStat))
+	{
+		fail(s, "failed to open '%s'", req->codepoints);
+		return 0;
+	}
+	
+	for (i = 0; i < s->sessionNum; ++i)
+	{
+		if (!strcmp(s->session[i].font, req->font)
+			&& !strcmp(s->session[i].codepoints, req->codepoints)
+		)
+		{
+			ses = &s->session[i];
+			break;
+		}
+	}
+	
+	/* a new pair takes the place of the least recently used one */
+	if (!ses)
+	{
+		if (s->sessionNum == SERVER_SESSION_MAX)
+		{
+			ses = s->session;
+			for (i = 1; i < s->sessionNum; ++i)
+				if (s->session[i].lastUse < ses->lastUse)
+					ses = &s->session[i];
+			dropSession(s, ses);
+		}
+		ses = &s->session[s->sessionNum++];
+		memset(ses, 0, sizeof(*ses));
+		ses->font = strdup(req->font);
+		ses->codepoints = strdup(req->codepoints);
+		ses->g.zchar = wow_calloc_die(ZCHAR_MAX, sizeof(struct zchar));
+		ses->fontStat.st_ino = -1;
+		ses->codepointsStat.st_ino = -1;
+	}
+	ses->lastUse = ++s->useCount;
+	
+	if (!sameFile(&ses->fontStat, &fontStat))
+	{
+		ses->isConverted = 0;
+		ses->fontStat = fontStat;
+		if (z64font_loadFont(&ses->g, req->font))
+			goto L_fail;
+	}
+	
+	/* rasters of glyphs still in use survive a codepoint change */
+	if (!sameFile(&ses->codepointsStat, &codepointsStat))
+	{
+		ses->isConverted = 0;
+		ses->codepointsStat = codepointsStat;
+		if (z64font_loadCodepoints(&ses->g, req->codepoints))
+			goto L_fail;
+	}
+	
+	return ses;
+L_fail:
+	fail(s, "%s", ses->g.lastError);
+	dropSession(s, ses);
+	return 0;
+}
+
+static int sameParams(const struct serverRequest *a, const struct serverRequest *b)
+{
+	return a->fontSize == b->fontSize
+		&& a->yshift == b->yshift
+		&& a->xPad == b->xPad
+		&& a->widthAdvance == b->widthAdvance
+		&& a->oversample == b->oversample
+		&& a->isSdf == b->isSdf
+		&& a->weight == b->weight
+	;
+}
+
+/* converts the glyphs the request's text needs, and only those; they
+ * stay converted until a request asks for different settings
+ */
+static int convertText(struct serverSession *ses, const struct serverRequest *req)
+{
+	struct z64font *g = &ses->g;
+	const char *line;
+	
+	if (!ses->isConverted || !sameParams(&ses->params, req))
+	{
+		g->fontSize = req->fontSize;
+		g->yshift = req->yshift;
+		g->xPad = req->xPad;
+		g->widthAdvance = req->widthAdvance;
+		g->oversample = req->oversample;
+		g->isSdf = req->isSdf;
+		g->weight = req->weight;
+		ses->isConverted = 0;
+		if (z64font_convertBegin(g))
+			return -1;
+		ses->params = *req;
+		ses->isConverted = 1;
+	}
+	
+	/* conversion of a string stops at the end of its line */
+	for (line = req->text; ; ++line)
+	{
+		if (z64font_convertCodepoints(g, line) < 0)
+		{
+			ses->isConverted = 0;
+			return -1;
+		}
+		line += strcspn(line, "\r\n");
+		if (!*line)
+			break;
+	}
+	
+	return 0;
+}
+
+static void opWidths(struct server *s, struct serverSession *ses, const struct serverRequest *req)
+{
+	struct z64font *g = &ses->g;
+	const char *next;
+	const char *w;
+	int missing = 0;
+	
+	replyf(s, "{\"ok\":true,\"widths\":[");
+	for (w = req->text; *w; w = next)
+	{
+		const struct zchar *z;
+		utf8_int32_t codepoint;
+		
+		next = utf8codepoint(w, &codepoint);
+		if (w != req->text)
+			replyf(s, ",");
+		if ((z = zchar_findCodepoint(g->zchar, g->zcharNum, codepoint)) && z->bitmap)
+			replyf(s, "%g", z->width);
+		else
+		{
+			replyf(s, "null");
+			++missing;
+		}
+	}
+	replyf(s, "],\"missing\":%d", missing);
+}
+
+/* places glyphs like the preview does, with a pen that advances by
+ * each glyph's width and drops FONT_H pixels a line; returns the
+ * number placed, and the canvas size needed in 'w' and 'h'
+ */
+static int layout(
+	struct server *s
+	, struct serverSession *ses
+	, const struct serverRequest *req
+	, int *w
+	, int *h
+	, int *missing
+)
+{
+	struct z64font *g = &ses->g;
+	const char *next;
+	const char *c;
+	int num = 0;
+	int x = 0;
+	int y = 0;
+	int i;
+	
+	*w = 0;
+	*missing = 0;
+	for (c = req->text; *c; c = next)
+	{
+		const struct zchar *z;
+		utf8_int32_t codepoint;
+		struct serverGlyph *p;
+		int inkX1;
+		
+		next = utf8codepoint(c, &codepoint);
+		
+		if (codepoint == '\r')
+			continue;
+		
+		/* a newline, or the explicit newline escape sequence */
+		if (codepoint == '\n' || (codepoint == '\\' && *next == 'n'))
+		{
+			if (codepoint == '\\')
+				++next;
+			x = 0;
+			y += FONT_H;
+			continue;
+		}
+		
+		if (!(z = zchar_findCodepoint(g->zchar, g->zcharNum, codepoint)) || !z->bitmap)
+		{
+			++*missing;
+			continue;
+		}
+		
+		if (req->wrap && x && x + z->width > req->wrap)
+		{
+			x = 0;
+			y += FONT_H;
+		}
+		
+		if (num == s->glyphMax)
+		{
+			s->glyphMax = s->glyphMax ? s->glyphMax * 2 : 256;
+			s->glyph = wow_realloc_die(s->glyph, s->glyphMax * sizeof(*p));
+		}
+		p = s->glyph + num++;
+		p->x = x;
+		p->y = y;
+		p->bitmap = z->bitmap;
+		x += z->width;
+		p->end = x;
+		
+		/* leave room for ink past the pen, but not past the cell */
+		inkX1 = z->inkX1 < FONT_W ? z->inkX1 : FONT_W;
+		if (p->end > *w)
+			*w = p->end;
+		if (p->x + inkX1 > *w)
+			*w = p->x + inkX1;
+	}
+	
+	if (req->wrap)
+		*w = req->wrap;
+	*h = y + FONT_H;
+	
+	/* right to left mirrors each pen span about the canvas */
+	if (req->rightToLeft)
+		for (i = 0; i < num; ++i)
+			s->glyph[i].x = *w - s->glyph[i].end;
+	
+	return num;
+}
+
+static int opRender(
+	struct server *s
+	, struct serverSession *ses
+	, const struct serverRequest *req
+	, uint8_t **canvas
+	, size_t *canvasSz
+)
+{
+	int num;
+	int w;
+	int h;
+	int missing;
+	int i;
+	
+	num = layout(s, ses, req, &w, &h, &missing);
+	if ((size_t)w * h > SERVER_CANVAS_MAX)
+	{
+		fail(s, "a %dx%d rendering is too large", w, h);
+		return -1;
+	}
+	*canvasSz = (size_t)w * h;
+	*canvas = wow_calloc_die(*canvasSz + 1, 1);
+	
+	/* blended by OR, like the preview */
+	for (i = 0; i < num; ++i)
+	{
+		const struct serverGlyph *p = s->glyph + i;
+		int x0 = p->x < 0 ? 0 : p->x;
+		int x1 = p->x + FONT_W > w ? w : p->x + FONT_W;
+		int k;
+		
+		for (k = 0; k < FONT_H && x0 < x1; ++k)
+		{
+			uint8_t *dst = *canvas + w * (p->y + k) + x0;
+			const uint8_t *src = p->bitmap + FONT_W * k + x0 - p->x;
+			int n;
+			
+			for (n = 0; n < x1 - x0; ++n)
+				dst[n] |= src[n];
+		}
+	}
+	
+	replyf(s, "{\"ok\":true,\"width\":%d,\"height\":%d,\"glyphs\":%d,\"missing\":%d"
+		, w, h, num, missing
+	);
+	
+	return 0;
+}
+
+static int sendAll(int fd, const void *data, size_t sz)
+{
+	const char *p = data;
+	
+	while (sz)
+	{
+		ssize_t n = send(fd, p, sz, MSG_NOSIGNAL);
+		
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			return -1;
+		p += n;
+		sz -= n;
+	}
+	
+	return 0;
+}
+
+/* answers one request line; returns non-zero if the client is gone */
+static int handleLine(struct server *s, int fd, char *line)
+{
+	struct z64font_stats stats = {0};
+	struct serverRequest req;
+	struct serverSession *ses = 0;
+	uint8_t *canvas = 0;
+	size_t canvasSz = 0;
+	double start = z64font_seconds();
+	int rval;
+	
+	*s->error = '\0';
+	s->replyLen = 0;
+	
+	if (parseRequest(s, line, &req))
+		goto L_error;
+	if (!req.op || (strcmp(req.op, "render") && strcmp(req.op, "widths")))
+	{
+		fail(s, "'op' must be render or widths");
+		goto L_error;
+	}
+	if (!req.text || utf8valid(req.text))
+	{
+		fail(s, "'text' must be a string of valid UTF-8");
+		goto L_error;
+	}
+	if (!(ses = getSession(s, &req)))
+		goto L_error;
+	
+	ses->g.stats = &stats;
+	rval = convertText(ses, &req);
+	ses->g.stats = 0;
+	if (rval)
+	{
+		fail(s, "%s", ses->g.lastError);
+		goto L_error;
+	}
+	
+	if (!strcmp(req.op, "widths"))
+		opWidths(s, ses, &req);
+	else if (opRender(s, ses, &req, &canvas, &canvasSz))
+		goto L_error;
+	
+	replyf(s, ",\"converted\":%u,\"rasterized\":%u,\"wall_ms\":%.3f,\"bytes\":%lu}\n"
+		, stats.glyphs
+		, stats.glyphsRasterized
+		, (z64font_seconds() - start) * 1000
+		, (unsigned long)canvasSz
+	);
+	rval = sendAll(fd, s->reply, s->replyLen) || sendAll(fd, canvas, canvasSz);
+	free(canvas);
+	return rval;
+L_error:
+	s->replyLen = 0;
+	replyf(s, "{\"ok\":false,\"error\":");
+	replyString(s, *s->error ? s->error : "request failed");
+	replyf(s, "}\n");
+	return sendAll(fd, s->reply, s->replyLen);
+}
+
+/* reads what the client sent and answers every complete line; returns
+ * non-zero once the client should be disconnected
+ */
+static int serveClient(struct server *s, struct serverClient *c)
+{
+	ssize_t n;
+	char *line;
+	char *end;
+	
+	if (c->len + 4096 + 1 > c->max)
+	{
+		c->max = (c->len + 4096 + 1) * 2;
+		c->buf = wow_realloc_die(c->buf, c->max);
+	}
+	
+	n = recv(c->fd, c->buf + c->len, c->max - c->len - 1, 0);
+	if (n <= 0)
+		return n < 0 && errno == EINTR ? 0 : -1;
+	c->len += n;
+	c->buf[c->len] = '\0';
+	
+	for (line = c->buf; (end = memchr(line, '\n', c->buf + c->len - line)); line = end + 1)
+	{
+		*end = '\0';
+		if (*line && handleLine(s, c->fd, line))
+			return -1;
+	}
+	
+	c->len -= line - c->buf;
+	memmove(c->buf, line, c->len);
+	
+	if (c->len > SERVER_LINE_MAX)
+	{
+		s->replyLen = 0;
+		replyf(s, "{\"ok\":false,\"error\":\"requests are limited to %d bytes\"}\n"
+			, SERVER_LINE_MAX
+		);
+		sendAll(c->fd, s->reply, s->replyLen);
+		return -1;
+	}
+	
+	return 0;
+}
+
+static int listenOn(const char *path)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	struct stat st;
+	int fd;
+	
+	if (strlen(path) >= sizeof(addr.sun_path))
+	{
+		wow_stderr("socket path '%s' is too long\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+	
+	/* a server that was killed leaves its socket behind */
+	if (!lstat(path, &st))
+	{
+		if (!S_ISSOCK(st.st_mode))
+		{
+			wow_stderr("'%s' exists and is not a socket\n", path);
+			return -1;
+		}
+		unlink(path);
+	}
+	
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0
+		|| bind(fd, (struct sockaddr*)&addr, sizeof(addr))
+		|| listen(fd, SERVER_CLIENT_MAX)
+	)
+	{
+		wow_stderr("failed to listen on '%s'\n", path);
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	
+	return fd;
+}
+
+int server_run(const char *path, FILE *out)
+{
+	struct server s = {0};
+	struct pollfd pfd[SERVER_CLIENT_MAX + 1];
+	struct sigaction sa = { .sa_handler = onSignal };
+	int fd = listenOn(path);
+	int i;
+	
+	if (fd < 0)
+		return -1;
+	
+	/* no SA_RESTART, so poll() wakes up to quit */
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, 0);
+	sigaction(SIGTERM, &sa, 0);
+	
+	fprintf(out, "listening=%s\n", path);
+	fflush(out);
+	
+	while (!isInterrupted)
+	{
+		pfd[0].fd = fd;
+		pfd[0].events = POLLIN;
+		for (i = 0; i < s.clientNum; ++i)
+		{
+			pfd[i + 1].fd = s.client[i].fd;
+			pfd[i + 1].events = POLLIN;
+		}
+		
+		if (poll(pfd, s.clientNum + 1, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			wow_stderr("failed to wait for requests\n");
+			break;
+		}
+		
+		/* clients are served in turn, a request line at a time */
+		for (i = s.clientNum - 1; i >= 0; --i)
+		{
+			struct serverClient *c = &s.client[i];
+			
+			if (!pfd[i + 1].revents || !serveClient(&s, c))
+				continue;
+			close(c->fd);
+			free(c->buf);
+			*c = s.client[--s.clientNum];
+		}
+		
+		if (pfd[0].revents & POLLIN)
+		{
+			int cfd = accept(fd, 0, 0);
+			
+			if (cfd < 0)
+				continue;
+			if (s.clientNum == SERVER_CLIENT_MAX)
+			{
+				close(cfd);
+				continue;
+			}
+			s.client[s.clientNum++] = (struct serverClient){ .fd = cfd };
+		}
+	}
+	
+	for (i = 0; i < s.clientNum; ++i)
+	{
+		close(s.client[i].fd);
+		free(s.client[i].buf);
+	}
+	for (i = 0; i < s.sessionNum; ++i)
+		freeSession(&s.session[i]);
+	free(s.reply);
+	free(s.glyph);
+	close(fd);
+	unlink(path);
+	
+	return isInterrupted ? 0 : -1;
+}
+
+#else
+
+int server_run(const char *path, FILE *out)
+{
+	(void)path;
+	(void)out;
+	wow_stderr("the render server needs unix domain sockets\n");
+	return -1;
+}
+
+#endif /* !_WIN32 */
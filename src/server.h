@@ -0,0 +1,22 @@
+/* <z64.me> local socket render server for editors and tools */
+
+#ifndef Z64_SERVER_H_INCLUDED
+#define Z64_SERVER_H_INCLUDED
+
+#include <stdio.h>
+
+#define  SERVER_SESSION_MAX 8        /* font and codepoint pairs kept loaded */
+#define  SERVER_CLIENT_MAX 32
+#define  SERVER_LINE_MAX (1 << 20)   /* longest request accepted */
+
+/* listens on a unix domain socket for requests, one json object per
+ * line, and answers each with one json line; fonts, codepoint files
+ * and rasterized glyphs stay loaded between requests, and files are
+ * reloaded when they change on disk; see README.md for the protocol;
+ * runs until interrupted, then removes the socket and returns 0, or
+ * returns non-zero if it can't listen in the first place
+ */
+int server_run(const char *path, FILE *out);
+
+#endif
+
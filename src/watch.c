@@ -0,0 +1,252 @@
+/* <z64.me> re-export whenever an input file changes */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wow.h>
+
+#include "z64font.h"
+#include "watch.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+
+enum watchInput
+{
+	WATCH_TTF
+	, WATCH_CODEPOINTS
+	, WATCH_NAMES
+	, WATCH_INPUT_NUM
+};
+
+struct watchFile
+{
+	const char *fn;
+	const char *base; /* name within its directory */
+	int wd;           /* the directory's watch */
+	int isLoaded;     /* the latest (re)load succeeded */
+};
+
+static const char *inputName[WATCH_INPUT_NUM] = {
+	"font"
+	, "codepoints"
+	, "names"
+};
+
+static void quiet(void *udata, const char *fmt, ...)
+{
+	(void)udata;
+	(void)fmt;
+}
+
+/* editors tend to save by renaming a new file over the old one, which
+ * a watch on the file itself would lose track of, so the directory
+ * holding it is watched instead
+ */
+static int addWatch(int fd, struct watchFile *f)
+{
+	char *dir = strdup(f->fn);
+	char *slash = strrchr(dir, '/');
+	
+	f->base = f->fn + (slash ? slash - dir + 1 : 0);
+	if (!slash)
+		strcpy(dir, ".");
+	else if (slash == dir)
+		slash[1] = '\0';
+	else
+		*slash = '\0';
+	
+	f->wd = inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+	free(dir);
+	
+	return f->wd < 0;
+}
+
+/* blocks for events, flagging the inputs they concern in 'changed';
+ * returns non-zero if the watch broke down
+ */
+static int readEvents(int fd, const struct watchFile *file, int *changed)
+{
+	union
+	{
+		struct inotify_event ev;
+		char buf[4096];
+	} u;
+	ssize_t n = read(fd, u.buf, sizeof(u.buf));
+	char *p;
+	
+	if (n <= 0)
+		return -1;
+	
+	for (p = u.buf; p < u.buf + n; )
+	{
+		const struct inotify_event *ev = (void*)p;
+		int i;
+		
+		for (i = 0; i < WATCH_INPUT_NUM; ++i)
+		{
+			if (file[i].fn && ev->wd == file[i].wd && ev->len
+				&& !strcmp(ev->name, file[i].base)
+			)
+				*changed |= 1 << i;
+		}
+		p += sizeof(*ev) + ev->len;
+	}
+	
+	return 0;
+}
+
+static int exportAll(struct z64font *g, const struct watch_options *opt)
+{
+	char *ofn;
+	int rval;
+	
+	if (opt->targetNum)
+		return z64font_exportTargets(g, opt->target, opt->targetNum, opt->out);
+	
+	ofn = strdup(opt->out);
+	if (g->isDecompMode)
+		rval = z64font_exportDecomp(g, &ofn);
+	else
+		rval = z64font_exportBinaries(g, &ofn);
+	free(ofn);
+	
+	return rval;
+}
+
+/* reloads what changed, reconverts if need be, and exports */
+static void rebuild(
+	struct z64font *g
+	, const struct watch_options *opt
+	, struct watchFile *file
+	, int changed
+	, FILE *out
+)
+{
+	struct z64font_stats stats = {0};
+	double start = z64font_seconds();
+	char what[64] = "none";
+	int failed = 0;
+	int i;
+	
+	g->stats = &stats;
+	
+	/* a new font makes every raster stale; new codepoints only need
+	 * the glyphs that weren't in use before (see loadCodepoints)
+	 */
+	if (changed & (1 << WATCH_TTF))
+		file[WATCH_TTF].isLoaded = !z64font_loadFont(g, file[WATCH_TTF].fn);
+	if (changed & (1 << WATCH_CODEPOINTS))
+		file[WATCH_CODEPOINTS].isLoaded = !z64font_loadCodepoints(g, file[WATCH_CODEPOINTS].fn);
+	if (changed & (1 << WATCH_NAMES))
+		file[WATCH_NAMES].isLoaded = !z64font_loadDecompFileNames(g, file[WATCH_NAMES].fn);
+	
+	if (changed)
+		*what = '\0';
+	for (i = 0; i < WATCH_INPUT_NUM; ++i)
+	{
+		if (changed & (1 << i))
+			snprintf(what + strlen(what), sizeof(what) - strlen(what), "%s%s"
+				, *what ? "," : ""
+				, inputName[i]
+			);
+		
+		/* a half-written file; wait for it to be saved again */
+		if (file[i].fn && !file[i].isLoaded)
+			failed = 1;
+	}
+	
+	if (!failed && (changed & ((1 << WATCH_TTF) | (1 << WATCH_CODEPOINTS))))
+		failed = z64font_convert(g) != 0;
+	if (!failed)
+		failed = exportAll(g, opt) != 0;
+	
+	fprintf(out
+		, "changed=%s glyphs=%u rasterized=%u written=%u unchanged=%u"
+		" wall_ms=%.3f status=%s\n"
+		, what
+		, g->zcharNum
+		, stats.glyphsRasterized
+		, stats.filesWritten
+		, stats.filesUnchanged
+		, (z64font_seconds() - start) * 1000
+		, failed ? "failed" : "ok"
+	);
+	fflush(out);
+	g->stats = 0;
+}
+
+int watch_run(struct z64font *g, const struct watch_options *opt, FILE *out)
+{
+	struct watchFile file[WATCH_INPUT_NUM] = {
+		{ .fn = opt->ttf }
+		, { .fn = opt->codepoints }
+		, { .fn = opt->names }
+	};
+	int debounceMs = opt->debounceMs > 0 ? opt->debounceMs : WATCH_DEBOUNCE_MS;
+	void (*info)(void *udata, const char *fmt, ...) = g->info;
+	struct z64font_stats *stats = g->stats;
+	int fd = inotify_init1(IN_CLOEXEC);
+	int i;
+	
+	if (fd < 0)
+	{
+		g->error(g->udata, "failed to start watching for changes\n");
+		return -1;
+	}
+	for (i = 0; i < WATCH_INPUT_NUM; ++i)
+	{
+		if (!file[i].fn)
+			continue;
+		if (addWatch(fd, &file[i]))
+		{
+			g->error(g->udata, "failed to watch '%s'\n", file[i].fn);
+			close(fd);
+			return -1;
+		}
+		file[i].isLoaded = 1;
+	}
+	
+	/* the export lines say it all */
+	g->info = quiet;
+	g->skipUnchanged = 1;
+	rebuild(g, opt, file, 0, out);
+	
+	while (1)
+	{
+		struct pollfd pfd = { .fd = fd, .events = POLLIN };
+		int changed = 0;
+		
+		/* wait for a change, then for a burst of saves to end */
+		if (readEvents(fd, file, &changed))
+			break;
+		while (poll(&pfd, 1, debounceMs) > 0)
+			if (readEvents(fd, file, &changed))
+				goto L_broken;
+		
+		if (changed)
+			rebuild(g, opt, file, changed, out);
+	}
+	
+L_broken:
+	g->error(g->udata, "stopped watching for changes\n");
+	g->info = info;
+	g->stats = stats;
+	g->skipUnchanged = 0;
+	close(fd);
+	return -1;
+}
+
+#else
+
+int watch_run(struct z64font *g, const struct watch_options *opt, FILE *out)
+{
+	(void)opt;
+	(void)out;
+	g->error(g->udata, "watching for changes needs inotify, so it's linux only\n");
+	return -1;
+}
+
+#endif /* __linux__ */
@@ -0,0 +1,33 @@
+/* <z64.me> re-export whenever an input file changes */
+
+#ifndef Z64_WATCH_H_INCLUDED
+#define Z64_WATCH_H_INCLUDED
+
+#include <stdio.h>
+
+#include "z64font.h"
+
+#define  WATCH_DEBOUNCE_MS 200 /* default quiet time after a change */
+
+struct watch_options
+{
+	const char *ttf;
+	const char *codepoints;
+	const char *names;      /* decomp png names; 0 = none */
+	const char *out;        /* as passed to convert */
+	const struct z64font_target **target; /* 0 = export like convert */
+	int targetNum;
+	int debounceMs;         /* wait this long for a burst of saves to end */
+};
+
+/* exports 'g' (which must already be loaded from opt's files), then
+ * waits for its inputs to change; whatever changed is reloaded, only
+ * glyphs not rasterized before are rasterized, and only outputs whose
+ * contents differ are rewritten; prints one line of key=value pairs per
+ * export; runs until killed, so it only returns (non-zero) if watching
+ * can't begin or breaks down; needs inotify, so Linux only
+ */
+int watch_run(struct z64font *g, const struct watch_options *opt, FILE *out);
+
+#endif
+
@@ -12,13 +12,25 @@
 #include <math.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <pthread.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <time.h>
+#endif
 
-#define WOW_IMPLEMENTATION
 #include <wow.h>
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "stb_image_write.h"
 
+/* stb_truetype's allocations are accounted to the z64font they're for */
+static void *stbttAlloc(size_t sz, void *udata);
+static void stbttFree(void *p, void *udata);
+#define STBTT_malloc(x,u) stbttAlloc(x, u)
+#define STBTT_free(x,u) stbttFree(x, u)
 #define STB_TRUETYPE_IMPLEMENTATION
 
 #include "z64font.h"
@@ -29,7 +41,7 @@
  *
  */
 
-/* compose codepoint in i8 color space */
+/* compose codepoint in i8 color space, measuring its ink on the way */
 static void compose(
 	int x
 	, int y
@@ -38,417 +50,2086 @@ static void compose(
 	, uint8_t *src
 	, uint8_t *dst
 	, int yshift
+	, struct zchar *zchar
 )
 {
-	int i;
+	int inkX0 = w;
+	int inkY0 = h;
+	int inkX1 = 0;
+	int inkY1 = 0;
+	int inside = 0;
+	int total = 0;
 	int k;
 	
 	memset(dst, 0, FONT_W * FONT_H);
+	y += yshift;
 	
 	for (k = 0; k < h; ++k)
 	{
+		const uint8_t *row = src + k * w;
+		int start = (k + y) * FONT_W + x;
+		int i0 = 0;
+		int i1 = w;
+		int c0 = 0;
+		int c1 = w;
+		int i;
+		
+		/* the span of this row that lands in the cell, bounds checks
+		 * hoisted; pixels past the right edge land on the next row, as
+		 * they always have, so output stays the same
+		 */
+		if (i0 < -x)
+			i0 = -x;
+		if (i0 < -start)
+			i0 = -start;
+		if (i1 > FONT_W * FONT_H - start)
+			i1 = FONT_W * FONT_H - start;
+		if (i0 < i1)
+			memcpy(dst + start + i0, row + i0, i1 - i0);
+		
+		/* of which this is what really belongs to the cell */
+		if (c0 < -x)
+			c0 = -x;
+		if (c1 > FONT_W - x)
+			c1 = FONT_W - x;
+		if (k + y < 0 || k + y >= FONT_H)
+			c1 = c0;
+		
 		for (i = 0; i < w; ++i)
 		{
-			int dstIdx = ((k + y) + yshift) * FONT_W + i + x;
-			
-			/* skip anything out of bounds */
-			if (i + x < 0 || dstIdx < 0 || dstIdx >= FONT_W * FONT_H)
+			if (!row[i])
 				continue;
-			dst[dstIdx] = src[k * w + i];
-			//fputc(" .:ioVM@"[src[k*w+i]>>5], stderr);
+			total += 1;
+			inside += i >= c0 && i < c1;
+			if (i < inkX0)
+				inkX0 = i;
+			if (i >= inkX1)
+				inkX1 = i + 1;
+			if (k < inkY0)
+				inkY0 = k;
+			inkY1 = k + 1;
 		}
-		//fputc('\n', stderr);
 	}
+	
+	if (!total)
+		inkX0 = inkX1 = inkY0 = inkY1 = 0;
+	zchar->inkX0 = x + inkX0;
+	zchar->inkX1 = x + inkX1;
+	zchar->inkY0 = y + inkY0;
+	zchar->inkY1 = y + inkY1;
+	zchar->clipped = total - inside;
 }
 
-static void i8_to_i4(uint8_t *dst, uint8_t *src, int w, int h)
+/* i4 quantization state; the tone curve is folded into every table, so
+ * each quantizer makes a single pass over the glyph
+ */
+struct quantizer
+{
+	enum z64font_quantizer kind;
+	uint8_t tone[256];     /* i8 after gamma and contrast */
+	uint8_t level[256];    /* nearest i4 level of an i8 value */
+	uint8_t lut[16][256];  /* i8 to i4 with tone (and threshold, by
+	                        * 4x4 bayer position) already applied */
+};
+
+static void quantizerInit(struct quantizer *q, const struct z64font *g)
 {
-	/* color points to last color */
-	int alt = 0;
+	static const uint8_t bayer[16] = {
+		0, 8, 2, 10
+		, 12, 4, 14, 6
+		, 3, 11, 1, 9
+		, 15, 7, 13, 5
+	};
+	float gamma = g->gamma > 0 ? g->gamma : 1;
+	float contrast = g->contrast > 0 ? g->contrast : 1;
 	int i;
+	int p;
+	
+	q->kind = g->quantizer;
 	
-	for (i = 0; i < w * h; ++i, ++src)
+	for (i = 0; i < 256; ++i)
 	{
-		uint8_t *b = dst;
-		uint8_t  c;
+		float v = i;
 		float f;
 		
-		c = *b;
-		b = &c;
-		
-		/* convert pixel */
-		f = 0.003921569f * *src;
-		*b = roundf(f * 15);
-		
-		/* clear when we initially find it */
-		if (!(alt&1))
-			*dst = 0;
-		
-		/* how to transform result */
-		if (!(alt&1))
-			c <<= 4;
-		else
-			c &= 15;
+		if (gamma != 1)
+			v = 255 * powf(v / 255, 1 / gamma);
+		if (contrast != 1)
+			v = (v - 127.5f) * contrast + 127.5f;
+		q->tone[i] = v < 0 ? 0 : v > 255 ? 255 : roundf(v);
 		
-		*dst |= c;
+		/* same arithmetic as ever, so default output doesn't change */
+		f = 0.003921569f * i;
+		q->level[i] = roundf(f * 15);
+	}
+	
+	for (p = 0; p < 16; ++p)
+	{
+		/* thresholds spread evenly across one i4 step (17 in i8) */
+		float bias = q->kind == Z64FONT_QUANTIZE_BAYER
+			? (bayer[p] * 2 - 15) * 17 / 32.0f
+			: 0
+		;
 		
-		/* pixel advancement logic */
-		dst += ((alt++)&1);
+		for (i = 0; i < 256; ++i)
+		{
+			float v = q->tone[i] + bias;
+			
+			q->lut[p][i] = q->level[v < 0 ? 0 : v > 255 ? 255 : (int)roundf(v)];
+		}
 	}
 }
 
-static void *quickWidth(float width)
+/* error diffusion confined to one cell, pipelined over a ring of three
+ * rows of pending error with two columns of margin either side
+ */
+static void diffuse(uint8_t *lv, const uint8_t *src, const struct quantizer *q)
 {
-	static uint8_t arr[4];
-	unsigned int widthU32;
-	widthU32 = *((unsigned int*)&width);
-	arr[0] = widthU32 >> 24;
-	arr[1] = widthU32 >> 16;
-	arr[2] = widthU32 >> 8;
-	arr[3] = widthU32;
-	return arr;
+	float err[3][FONT_W + 4] = {{0}};
+	int isAtkinson = q->kind == Z64FONT_QUANTIZE_ATKINSON;
+	int x;
+	int y;
+	
+	for (y = 0; y < FONT_H; ++y)
+	{
+		float *e0 = err[y % 3] + 2;
+		float *e1 = err[(y + 1) % 3] + 2;
+		float *e2 = err[(y + 2) % 3] + 2;
+		
+		for (x = 0; x < FONT_W; ++x)
+		{
+			float v = q->tone[*src++] + e0[x];
+			int c = v < 0 ? 0 : v > 255 ? 255 : (int)roundf(v);
+			float e;
+			
+			*lv = q->level[c];
+			e = v - *lv++ * 17;
+			
+			if (isAtkinson)
+			{
+				e *= 1.0f / 8;
+				e0[x + 1] += e;
+				e0[x + 2] += e;
+				e1[x - 1] += e;
+				e1[x] += e;
+				e1[x + 1] += e;
+				e2[x] += e;
+			}
+			else
+			{
+				e *= 1.0f / 16;
+				e0[x + 1] += e * 7;
+				e1[x - 1] += e * 3;
+				e1[x] += e * 5;
+				e1[x + 1] += e;
+			}
+		}
+		
+		/* this row becomes the one two rows down */
+		memset(e0 - 2, 0, sizeof(err[0]));
+	}
 }
 
-/* read file from drive; returns 0 on failure */
-static void *readFile(struct z64font *g, const char *fn, unsigned *sz)
+/* quantize a composed i8 glyph, two pixels per output byte */
+static void i8_to_i4(uint8_t *dst, const uint8_t *src, const struct quantizer *q)
 {
-	void *data;
-	unsigned sz_;
-	if (!sz)
-		sz = &sz_;
-	FILE *fp = fopen(fn, "rb");
-	if (!fp)
+	uint8_t lv[FONT_W * FONT_H];
+	int i;
+	
+	switch (q->kind)
 	{
-		g->error("failed to open '%s' for reading", fn);
-		return 0;
+		case Z64FONT_QUANTIZE_FLOYD_STEINBERG:
+		case Z64FONT_QUANTIZE_ATKINSON:
+			diffuse(lv, src, q);
+			break;
+		
+		case Z64FONT_QUANTIZE_BAYER:
+			for (i = 0; i < FONT_W * FONT_H; ++i)
+				lv[i] = q->lut[((i / FONT_W) & 3) * 4 + (i & 3)][src[i]];
+			break;
+		
+		default:
+			for (i = 0; i < FONT_W * FONT_H; ++i)
+				lv[i] = q->lut[0][src[i]];
+			break;
 	}
 	
-	/* get file size */
-	fseek(fp, 0, SEEK_END);
-	*sz = ftell(fp);
-	fseek(fp, 0, SEEK_SET);
+	for (i = 0; i < FONT_W * FONT_H; i += 2)
+		*dst++ = (lv[i] << 4) | lv[i + 1];
+}
+
+/* stage timing; these cost a branch and nothing more without stats */
+struct stageClock
+{
+	double wall;
+	double cpu;
+};
+
+/* cpu time consumed by the calling thread, in seconds */
+static double threadCpuSeconds(void)
+{
+#ifdef _WIN32
+	FILETIME c;
+	FILETIME e;
+	FILETIME k;
+	FILETIME u;
 	
-	/* allocate memory to store file */
-	data = malloc(*sz+1);
-	if (!data)
-	{
-		fclose(fp);
+	if (!GetThreadTimes(GetCurrentThread(), &c, &e, &k, &u))
 		return 0;
-	}
-	((char*)data)[*sz] = '\0'; /* in case used as string */
+	return (
+		((uint64_t)k.dwHighDateTime << 32 | k.dwLowDateTime)
+		+ ((uint64_t)u.dwHighDateTime << 32 | u.dwLowDateTime)
+	) * 1e-7;
+#elif defined(CLOCK_THREAD_CPUTIME_ID)
+	struct timespec ts;
 	
-	/* doing it in a single read failed... */
-	if (fread(data, 1, *sz, fp) != *sz)
-	{
-		fclose(fp);
-		free(data);
-		g->error("failed to read file '%s'", fn);
-		return 0;
-	}
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+static struct stageClock stageBegin(struct z64font *g)
+{
+	struct stageClock t = {0};
 	
-	fclose(fp);
-	return data;
+	if (!g->stats)
+		return t;
+	t.wall = z64font_seconds();
+	t.cpu = threadCpuSeconds();
+	return t;
 }
 
-/* read file from drive as string; returns 0 on failure */
-static char *readFileString(struct z64font *g, const char *fn)
+static struct stageClock stageEnd(
+	struct z64font *g
+	, enum z64font_stage stage
+	, struct stageClock t0
+)
 {
-	char *data;
-	unsigned dataSz;
-	data = readFile(g, fn, &dataSz);
-	if (!data)
-		return 0;
-	data[dataSz] = '\0';
-	return data;
+	struct stageClock t1;
+	
+	if (!g->stats)
+		return t0;
+	t1 = stageBegin(g);
+	g->stats->wall[stage] += t1.wall - t0.wall;
+	g->stats->cpu[stage] += t1.cpu - t0.cpu;
+	return t1;
 }
 
-/*
- *
- * public api
- *
+/* counters; likewise free without stats */
+#define STAT_ADD(G, FIELD, N) do { \
+	if ((G)->stats) \
+		(G)->stats->FIELD += (N); \
+} while (0)
+
+/* errors are kept with the z64font they happened to, so threads
+ * converting different fonts never share where messages end up; the
+ * callbacks are optional
  */
+static void fail(struct z64font *g, const char *fmt, ...)
+{
+	char msg[sizeof(g->lastError)];
+	size_t len;
+	va_list ap;
+	
+	va_start(ap, fmt);
+	vsnprintf(msg, sizeof(msg), fmt, ap);
+	va_end(ap);
+	
+	/* some messages end in a newline, some don't; report with exactly one */
+	len = strlen(msg);
+	while (len && msg[len - 1] == '\n')
+		msg[--len] = '\0';
+	memcpy(g->lastError, msg, len + 1);
+	
+	if (g->error)
+		g->error(g->udata, "%s\n", msg);
+}
 
+static void inform(struct z64font *g, const char *msg)
+{
+	if (g->info)
+		g->info(g->udata, "%s", msg);
+}
 
-void z64font_exportDecomp(struct z64font *g, char **ofn)
+/* memory accounting; everything the core allocates for a font goes
+ * through these, so memPeak covers whole conversions and a budget can
+ * fail them cleanly instead of exhausting the host
+ */
+static void *allocate(struct z64font *g, size_t sz)
 {
-	FILE *fp = 0;
-	struct zchar *zchar;
-	const char *delim = "\r\n";
-	char *pngFn = 0;
-	char *decompFileNames = strdup(g->decompFileNames);
-	unsigned char rgbaBuf[FONT_W * FONT_H][4];
-	const float extraWidthEntries[] = {
-		14.0f, // '[A]'
-		14.0f, // '[B]'
-		14.0f, // '[C]'
-		14.0f, // '[L]'
-		14.0f, // '[R]'
-		14.0f, // '[Z]'
-		14.0f, // '[C-Up]'
-		14.0f, // '[C-Down]'
-		14.0f, // '[C-Left]'
-		14.0f, // '[C-Right]'
-		14.0f, // '▼'
-		14.0f, // '[Control-Pad]'
-		14.0f, // '[D-Pad]'
-		14.0f, // ?
-		14.0f, // ?
-		14.0f, // ?
-		14.0f, // ?
-	};
+	void *p = 0;
+	
+	if (!g->memBudget || g->memCurrent + sz <= g->memBudget)
+		p = malloc(sz);
+	
+	if (!p)
+	{
+		if (!g->isOverBudget && g->memBudget)
+			fail(g, "memory budget of %llu bytes exceeded"
+				, (unsigned long long)g->memBudget
+			);
+		else if (!g->isOverBudget)
+			fail(g, "memory error");
+		g->isOverBudget = 1;
+		return 0;
+	}
 	
-	if (!ofn || !*ofn || !decompFileNames)
+	g->memCurrent += sz;
+	if (g->memCurrent > g->memPeak)
+		g->memPeak = g->memCurrent;
+	if (g->stats && g->memCurrent > g->stats->memPeak)
+		g->stats->memPeak = g->memCurrent;
+	STAT_ADD(g, allocations, 1);
+	
+	return p;
+}
+
+static void release(struct z64font *g, void *p, size_t sz)
+{
+	if (!p)
 		return;
+	
+	free(p);
+	g->memCurrent -= sz;
+}
 
-	pngFn = strtok(decompFileNames, delim);
+/* bump allocation out of chunks that are only ever freed all at once */
+struct z64font_slab
+{
+	struct z64font_slab *next;
+	size_t size; /* usable bytes */
+	size_t used;
+};
+#define SLAB_HEADER ((sizeof(struct z64font_slab) + 15) & ~15)
+#define SLAB_ALIGN(X) (((X) + 7) & ~(size_t)7)
+#define SLAB_SCRATCH_MIN (64 << 10)
+#define SLAB_RASTER_MIN (16 << 10)
 
-	for (zchar = g->zchar; zchar->bitmap; ++zchar)
-	{
-		/* convert i8 to rgba32 */
-		for (int i = 0; i < FONT_W * FONT_H; ++i)
-		{
-			rgbaBuf[i][0] = rgbaBuf[i][1] = rgbaBuf[i][2] = ((unsigned char *)zchar->bitmap)[i]; /* rgb */
-			rgbaBuf[i][3] = 255; /* a */
-		}
-		stbi_write_png(pngFn, FONT_W, FONT_H, 4, rgbaBuf, FONT_W * 4);
-		pngFn = strtok(0, delim);
-	}
+/* distance fields span this many pixels either side of an edge */
+#define SDF_PADDING 8
+#define SDF_ONEDGE 128
 
-	g->isI4 = 1; /* has converted to i4 */
+static void *slabAlloc(
+	struct z64font *g
+	, struct z64font_slab **head
+	, size_t sz
+	, size_t min
+)
+{
+	struct z64font_slab *s = *head;
 	
-	/* export 'comic-sans.font_width.h' */
-	fp = fopen(*ofn, "w");
-	if (!fp)
-	{
-		g->error("failed to open '%s' for writing\n", *ofn);
-		goto L_cleanup;
-	}
-	for (zchar = g->zchar; zchar->bitmap; ++zchar)
+	sz = SLAB_ALIGN(sz);
+	if (!s || s->used + sz > s->size)
 	{
-		if (fprintf(fp, "%ff,\n", zchar->width) < 0)
-		{
-			g->error("failed to write '%s'\n", *ofn);
-			goto L_cleanup;
-		}
+		size_t size = sz > min ? sz : min;
+		
+		if (!(s = allocate(g, SLAB_HEADER + size)))
+			return 0;
+		s->next = *head;
+		s->size = size;
+		s->used = 0;
+		*head = s;
 	}
-	for (int i = 0; i < sizeof(extraWidthEntries) / sizeof(extraWidthEntries[0]); ++i)
+	
+	s->used += sz;
+	return (unsigned char*)s + SLAB_HEADER + s->used - sz;
+}
+
+static void slabFree(struct z64font *g, struct z64font_slab **head)
+{
+	struct z64font_slab *s;
+	struct z64font_slab *next;
+	
+	for (s = *head; s; s = next)
 	{
-		if (fprintf(fp, "%ff,\n", extraWidthEntries[i]) < 0)
-		{
-			g->error("failed to write '%s'\n", *ofn);
-			goto L_cleanup;
-		}
+		next = s->next;
+		release(g, s, SLAB_HEADER + s->size);
 	}
-	fclose(fp);
-	fp = 0;
-	g->info("Export successful!\n");
-L_cleanup:
-	free(decompFileNames);
-	if (fp)
-		fclose(fp);
+	*head = 0;
 }
 
-void z64font_exportBinaries(struct z64font *g, char **ofn)
+/* called after every glyph; scratch that spilled into extra chunks is
+ * merged into one big enough for it, so steady state makes no heap calls
+ */
+static void scratchReset(struct z64font *g)
 {
-	FILE *fp = 0;
-	struct zchar *zchar;
+	struct z64font_slab *s = g->scratch;
+	size_t need = 0;
 	
-	if (!ofn || !*ofn)
+	if (!s)
 		return;
 	
-	/* export 'comic-sans.font_static' */
-	if (wow_fnChangeExtension(ofn, "font_static"))
+	if (s->next)
 	{
-		g->error("memory error");
-		goto L_cleanup;
-	}
-	fp = fopen(*ofn, "wb");
-	if (!fp)
-	{
-		g->error("failed to open '%s' for writing\n", *ofn);
-		goto L_cleanup;
-	}
-	for (zchar = g->zchar; zchar->bitmap; ++zchar)
-	{
-		if (!g->isI4)
-			i8_to_i4(zchar->bitmap, zchar->bitmap, FONT_W, FONT_H);
-		if (fwrite(zchar->bitmap, 1, (FONT_W * FONT_H) / 2, fp)
-			!= (FONT_W * FONT_H) / 2
-		)
-		{
-			g->error("failed to write '%s'\n", *ofn);
-			goto L_cleanup;
-		}
+		for (; s; s = s->next)
+			need += s->used;
+		slabFree(g, &g->scratch);
+		if (slabAlloc(g, &g->scratch, need, SLAB_SCRATCH_MIN))
+			s = g->scratch;
 	}
-	fclose(fp);
-	fp = 0;
-	g->isI4 = 1; /* has converted to i4 */
 	
-	/* export 'comic-sans.width_table' */
-	if (wow_fnChangeExtension(ofn, "width_table"))
-	{
-		g->error("memory error");
-		goto L_cleanup;
-	}
-	fp = fopen(*ofn, "wb");
-	if (!fp)
-	{
-		g->error("failed to open '%s' for writing\n", *ofn);
-		goto L_cleanup;
-	}
-	for (zchar = g->zchar; zchar->bitmap; ++zchar)
-	{
-		if (fwrite(quickWidth(zchar->width), 1, 4, fp) != 4)
-		{
-			g->error("failed to write '%s'\n", *ofn);
-			goto L_cleanup;
-		}
-	}
-	fclose(fp);
-	fp = 0;
-	g->info("Export successful!\n");
-L_cleanup:
-	if (fp)
-		fclose(fp);
+	if (s)
+		s->used = 0;
+}
+
+/* stb_truetype only allocates scratch while rasterizing, so with a
+ * z64font attached, its allocations come from the font's scratch slab
+ * and freeing them is deferred to scratchReset()
+ */
+static void *stbttAlloc(size_t sz, void *udata)
+{
+	struct z64font *g = udata;
+	
+	if (!g)
+		return malloc(sz);
+	
+	return slabAlloc(g, &g->scratch, sz, SLAB_SCRATCH_MIN);
 }
 
+static void stbttFree(void *p, void *udata)
+{
+	if (!udata)
+		free(p);
+}
 
-int z64font_convert(struct z64font *g)
+/* write bytes, accounting for them as the write stage */
+static int writeBytes(struct z64font *g, const void *data, size_t sz, FILE *fp)
 {
-	float scale;
-	int ascent;
-	int baseline;
-	uint8_t *bitmap;
-	struct zchar *zchar;
-	const char *chars = g->chars;
-	stbtt_fontinfo *font = &g->font;
-	int yshift = g->yshift;
-	int fontSize = g->fontSize;
-	int xPad = g->xPad;
-	int widthAdvance = g->widthAdvance;
-	struct zchar *arr = g->zchar;
-	int arrMax = ZCHAR_MAX;
+	struct stageClock t = stageBegin(g);
+	size_t wrote = fwrite(data, 1, sz, fp);
 	
-	g->isI4 = 0;
+	stageEnd(g, Z64FONT_STAGE_WRITE, t);
+	STAT_ADD(g, bytesWritten, wrote);
 	
-	scale = stbtt_ScaleForPixelHeight(font, fontSize);
-	stbtt_GetFontVMetrics(font, &ascent, 0, 0);
-	baseline = scale * ascent;
+	return wrote != sz;
+}
+
+/* FNV-1a over a composed i8 glyph */
+static uint32_t hashBitmap(const uint8_t *bitmap)
+{
+	uint32_t h = 2166136261u;
+	int i;
+	
+	for (i = 0; i < FONT_W * FONT_H; ++i)
+		h = (h ^ bitmap[i]) * 16777619u;
+	
+	return h;
+}
+
+/* moves cached rasters and distance fields from the zchar[] indices
+ * their glyphs used to have to the ones they have now; 'old' maps each
+ * glyph index to its previous zchar[] index, or -1
+ */
+static int remapRasters(struct z64font *g, const int *old)
+{
+	struct z64font_rasterSet *set;
+	struct zchar *zchar;
 	
-	/* get codepoints */
-	if (zchar_parseCodepoints(chars, arr, arrMax, &g->zcharNum))
+	for (set = g->rasterSet; set < g->rasterSet + Z64FONT_RASTER_SETS; ++set)
 	{
-		g->error("too many codepoints detected");
-		return -1;
+		struct z64font_raster *raster;
+		
+		if (!set->raster)
+			continue;
+		if (!(raster = allocate(g, ZCHAR_MAX * sizeof(*raster))))
+			return -1;
+		memset(raster, 0, ZCHAR_MAX * sizeof(*raster));
+		for (zchar = g->zchar; zchar < g->zchar + g->zcharNum; ++zchar)
+			if (zchar->first == zchar - g->zchar && old[zchar->glyph] >= 0)
+				raster[zchar - g->zchar] = set->raster[old[zchar->glyph]];
+		release(g, set->raster, ZCHAR_MAX * sizeof(*set->raster));
+		set->raster = raster;
+		set->next = 0;
 	}
 	
-	/* prepare each codepoint's graphic */
-	for (zchar = arr; zchar < arr + g->zcharNum; ++zchar)
+	if (g->sdf)
 	{
-		int width;
-		int height;
-		int xofs;
-		int yofs;
-		utf8_int32_t codepoint = zchar->codepoint;
-		uint8_t conv[FONT_W * FONT_H];
-		int advance;
-		int lsb;
-		
-		bitmap = stbtt_GetCodepointBitmap(
-			font
-			, 0
-			, scale
-			, codepoint
-			, &width
-			, &height
-			, &xofs
-			, &yofs
-		);
-		
-		//fprintf(stderr, "xofs yofs %d %d\n", xofs, yofs);
-		//fprintf(stderr, "ascent = %d\n", ascent);
-		//fprintf(stderr, "baseline = %d\n", baseline);
-		
-		compose(xofs, baseline + yofs, width, height, bitmap, conv, yshift);
-		stbtt_GetCodepointHMetrics(font, codepoint, &advance, &lsb);
-		
-		if (widthAdvance)
-			width = advance * scale;
-		else
-			width = fmax(width, advance * scale);
-		
-		width += xPad;
-		
-		zchar->codepoint = codepoint;
-		zchar->width = width;
-		if (!zchar->bitmap)
-		{
-			zchar->bitmap = wow_malloc_die(sizeof(conv));
-		}
-		memcpy(zchar->bitmap, conv, sizeof(conv));
+		struct z64font_sdf *sdf;
 		
-		free(bitmap);
+		if (!(sdf = allocate(g, ZCHAR_MAX * sizeof(*sdf))))
+			return -1;
+		memset(sdf, 0, ZCHAR_MAX * sizeof(*sdf));
+		for (zchar = g->zchar; zchar < g->zchar + g->zcharNum; ++zchar)
+			if (zchar->first == zchar - g->zchar && old[zchar->glyph] >= 0)
+				sdf[zchar - g->zchar] = g->sdf[old[zchar->glyph]];
+		release(g, g->sdf, ZCHAR_MAX * sizeof(*g->sdf));
+		g->sdf = sdf;
 	}
 	
 	return 0;
 }
 
-int z64font_loadFont(struct z64font *g, const char *fn)
+/* parse codepoints, map them to glyph indices, and link each zchar
+ * to the first zchar using the same glyph; with 'keepRasters' set, the
+ * font is known to be unchanged, so rasters cached for the previous
+ * codepoints are kept for glyphs still in use; returns non-zero on fail
+ */
+static int resolveGlyphs(struct z64font *g, int keepRasters)
 {
-	/* ttf changed */
-	if (g->ttfBin)
-		free(g->ttfBin);
-	
-	if (!fn || !strlen(fn))
-		return 1;
+	struct zchar *arr;
+	struct zchar *zchar;
+	int *first;
+	int *old = 0;
+	int numGlyphs = g->font.numGlyphs;
 	
-	if (!(g->ttfBin = readFile(g, fn, &g->ttfBinSz)))
-		return 1;
+	if (!g->zchar && !(g->zchar = calloc(ZCHAR_MAX, sizeof(*g->zchar))))
+	{
+		fail(g, "memory error");
+		return -1;
+	}
+	arr = g->zchar;
 	
-	if (!stbtt_InitFont(&g->font, g->ttfBin, 0))
+	/* cached rasters are indexed like zchar[], so note where they were */
+	if (keepRasters && (old = allocate(g, numGlyphs * sizeof(*old))))
 	{
-		free(g->ttfBin);
-		g->ttfBin = 0;
-		g->error("unsupported font file '%s'", fn);
-		return 1;
+		memset(old, -1, numGlyphs * sizeof(*old));
+		for (zchar = arr; zchar < arr + g->zcharNum; ++zchar)
+			if (zchar->first == zchar - arr)
+				old[zchar->glyph] = zchar - arr;
 	}
-	return 0;
-}
-
-int z64font_loadCodepoints(struct z64font *g, const char *fn)
-{
-	/* txt changed */
-	if (g->chars)
-		free(g->chars);
+	else
+		z64font_flushRasters(g);
 	
-	if (!fn || !strlen(fn))
-		return 1;
+	if (zchar_parseCodepoints(g->chars, arr, ZCHAR_MAX, &g->zcharNum))
+	{
+		fail(g, "too many codepoints detected");
+		g->zcharNum = 0;
+		release(g, old, numGlyphs * sizeof(*old));
+		z64font_flushRasters(g);
+		return -1;
+	}
 	
-	/* read characters as string */
-	if (!(g->chars = readFileString(g, fn)))
-		return 1;
+	if (!(first = allocate(g, numGlyphs * sizeof(*first))))
+	{
+		release(g, old, numGlyphs * sizeof(*old));
+		z64font_flushRasters(g);
+		return -1;
+	}
+	memset(first, -1, numGlyphs * sizeof(*first));
+	for (zchar = arr; zchar < arr + g->zcharNum; ++zchar)
+	{
+		int glyph = stbtt_FindGlyphIndex(&g->font, zchar->codepoint);
+		
+		/* a malformed cmap may point past the last glyph; every array
+		 * indexed by zchar->glyph, here and in remapRasters(), is sized
+		 * by numGlyphs, so such codepoints get .notdef instead
+		 */
+		if (glyph < 0 || glyph >= numGlyphs)
+			glyph = 0;
+		if (first[glyph] < 0)
+			first[glyph] = zchar - arr;
+		zchar->glyph = glyph;
+		zchar->first = first[glyph];
+	}
+	release(g, first, numGlyphs * sizeof(*first));
 	
-	if (utf8valid(g->chars))
+	if (old)
 	{
-		g->error("'%s' contains invalid codepoint(s)", fn);
-		return 1;
+		if (remapRasters(g, old))
+			z64font_flushRasters(g);
+		release(g, old, numGlyphs * sizeof(*old));
 	}
 	
+	g->isResolved = 1;
 	return 0;
 }
 
-int z64font_loadDecompFileNames(struct z64font *g, const char *fn)
+/* integer division rounding toward negative infinity */
+static int floorDiv(int a, int n)
 {
+	return a >= 0 ? a / n : -((n - 1 - a) / n);
+}
+
+/* box filter an n-times oversampled bitmap down to w x h; columns are
+ * summed across whole rows first so the inner loops stay contiguous
+ */
+static void boxFilter(
+	uint8_t *dst
+	, const uint8_t *src
+	, int w
+	, int h
+	, int n
+	, uint16_t *col
+)
+{
+	int stride = w * n;
+	int area = n * n;
+	int x;
+	int y;
+	int k;
+	
+	for (y = 0; y < h; ++y)
+	{
+		memset(col, 0, stride * sizeof(*col));
+		for (k = 0; k < n; ++k)
+		{
+			const uint8_t *row = src + (y * n + k) * stride;
+			
+			for (x = 0; x < stride; ++x)
+				col[x] += row[x];
+		}
+		
+		for (x = 0; x < w; ++x)
+		{
+			const uint16_t *c = col + x * n;
+			unsigned sum = 0;
+			
+			for (k = 0; k < n; ++k)
+				sum += c[k];
+			*dst++ = (sum + area / 2) / area;
+		}
+	}
+}
+
+/* the distance field for a zchar's glyph, made if it hasn't been yet */
+static struct z64font_sdf *sdfFor(struct z64font *g, struct zchar *zchar)
+{
+	struct z64font_sdf *sdf;
+	unsigned char *field;
+	
+	if (!g->sdf)
+	{
+		if (!(g->sdf = allocate(g, ZCHAR_MAX * sizeof(*g->sdf))))
+			return 0;
+		memset(g->sdf, 0, ZCHAR_MAX * sizeof(*g->sdf));
+	}
+	
+	sdf = g->sdf + (zchar - g->zchar);
+	if (sdf->isReady)
+		return sdf;
+	
+	/* made in scratch, so it's copied out before the scratch is reset */
+	field = stbtt_GetGlyphSDF(
+		&g->font
+		, stbtt_ScaleForPixelHeight(&g->font, Z64FONT_SDF_SIZE)
+		, zchar->glyph
+		, SDF_PADDING
+		, SDF_ONEDGE
+		, (float)SDF_ONEDGE / SDF_PADDING
+		, &sdf->w
+		, &sdf->h
+		, &sdf->x
+		, &sdf->y
+	);
+	if (field && (sdf->field = slabAlloc(g, &g->sdfSlab, sdf->w * sdf->h, SLAB_RASTER_MIN)))
+		memcpy(sdf->field, field, sdf->w * sdf->h);
+	else
+	{
+		sdf->w = sdf->h = 0;
+		if (g->isOverBudget)
+			return 0;
+	}
+	sdf->isReady = 1;
+	
+	return sdf;
+}
+
+/* bilinear sample of a distance field, clamped to its edges */
+static float sdfSample(const struct z64font_sdf *sdf, float u, float v)
+{
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+	float fx;
+	float fy;
+	const unsigned char *f = sdf->field;
+	
+	u = u < 0 ? 0 : u > sdf->w - 1 ? sdf->w - 1 : u;
+	v = v < 0 ? 0 : v > sdf->h - 1 ? sdf->h - 1 : v;
+	x0 = u;
+	y0 = v;
+	x1 = x0 + 1 < sdf->w ? x0 + 1 : x0;
+	y1 = y0 + 1 < sdf->h ? y0 + 1 : y0;
+	fx = u - x0;
+	fy = v - y0;
+	
+	return
+		(f[y0 * sdf->w + x0] * (1 - fx) + f[y0 * sdf->w + x1] * fx) * (1 - fy)
+		+ (f[y1 * sdf->w + x0] * (1 - fx) + f[y1 * sdf->w + x1] * fx) * fy
+	;
+}
+
+/* reconstruct a glyph at a set's size from its distance field; a
+ * smoothstep one pixel wide stands in for coverage, and weight shifts
+ * the edge it's centered on
+ */
+static void sdfRasterize(
+	struct z64font *g
+	, struct z64font_rasterSet *set
+	, struct zchar *zchar
+	, struct z64font_raster *r
+)
+{
+	struct z64font_sdf *sdf = sdfFor(g, zchar);
+	float k; /* cell pixels per field pixel */
+	float weight = set->weight / 10.0f;
+	uint8_t *dst;
+	int x;
+	int y;
+	
+	r->w = r->h = 0;
+	if (!sdf || !sdf->w || !sdf->h)
+		return;
+	
+	k = set->scale / stbtt_ScaleForPixelHeight(&g->font, Z64FONT_SDF_SIZE);
+	r->x = floorf(sdf->x * k);
+	r->y = floorf(sdf->y * k);
+	r->w = ceilf((sdf->x + sdf->w) * k) - r->x;
+	r->h = ceilf((sdf->y + sdf->h) * k) - r->y;
+	if (!(dst = r->bitmap = slabAlloc(g, &set->slab, r->w * r->h, SLAB_RASTER_MIN)))
+	{
+		r->w = r->h = 0;
+		return;
+	}
+	
+	for (y = 0; y < r->h; ++y)
+	{
+		float v = (r->y + y + 0.5f) / k - sdf->y - 0.5f;
+		
+		for (x = 0; x < r->w; ++x)
+		{
+			float u = (r->x + x + 0.5f) / k - sdf->x - 0.5f;
+			float d = sdfSample(sdf, u, v) - SDF_ONEDGE;
+			float t;
+			
+			/* distance in cell pixels, positive inside */
+			d = d * SDF_PADDING / SDF_ONEDGE * k + weight;
+			t = d + 0.5f;
+			t = t < 0 ? 0 : t > 1 ? 1 : t;
+			*dst++ = t * t * (3 - 2 * t) * 255 + 0.5f;
+		}
+	}
+}
+
+static void freeRasterSet(struct z64font *g, struct z64font_rasterSet *set)
+{
+	if (!set->raster)
+		return;
+	
+	slabFree(g, &set->slab);
+	release(g, set->raster, ZCHAR_MAX * sizeof(*set->raster));
+	g->rasterBytes -= set->bytes;
+	memset(set, 0, sizeof(*set));
+}
+
+/* find the rasters cached for a size; when 'create' is set, make room
+ * by evicting the size furthest from the one being converted; returns
+ * 0 if the size isn't cached and couldn't be
+ */
+static struct z64font_rasterSet *rasterSetFor(
+	struct z64font *g
+	, int fontSize
+	, int create
+)
+{
+	struct z64font_rasterSet *set;
+	struct z64font_rasterSet *worst = 0;
+	int oversample = g->oversample;
+	int isSdf = g->isSdf != 0;
+	int weight = isSdf ? g->weight : 0;
+	
+	/* distance fields are smooth already */
+	if (oversample < 1 || isSdf)
+		oversample = 1;
+	else if (oversample > Z64FONT_OVERSAMPLE_MAX)
+		oversample = Z64FONT_OVERSAMPLE_MAX;
+	if (weight < -Z64FONT_WEIGHT_MAX)
+		weight = -Z64FONT_WEIGHT_MAX;
+	else if (weight > Z64FONT_WEIGHT_MAX)
+		weight = Z64FONT_WEIGHT_MAX;
+	
+	for (set = g->rasterSet; set < g->rasterSet + Z64FONT_RASTER_SETS; ++set)
+	{
+		if (set->raster && set->fontSize == fontSize
+			&& set->oversample == oversample
+			&& set->isSdf == isSdf
+			&& set->weight == weight
+		)
+			return set;
+		if (!set->raster)
+			worst = set;
+		else if (!worst || (worst->raster
+			&& abs(set->fontSize - g->fontSize)
+				> abs(worst->fontSize - g->fontSize))
+		)
+			worst = set;
+	}
+	
+	if (!create)
+		return 0;
+	
+	freeRasterSet(g, worst);
+	if (!(worst->raster = allocate(g, ZCHAR_MAX * sizeof(*worst->raster))))
+		return 0;
+	memset(worst->raster, 0, ZCHAR_MAX * sizeof(*worst->raster));
+	worst->fontSize = fontSize;
+	worst->oversample = oversample;
+	worst->isSdf = isSdf;
+	worst->weight = weight;
+	worst->scale = stbtt_ScaleForPixelHeight(&g->font, fontSize);
+	
+	return worst;
+}
+
+/* keep cached rasters within budget, sparing the size in use */
+static void trimRasters(struct z64font *g)
+{
+	size_t budget = g->rasterBudget ? g->rasterBudget : Z64FONT_RASTER_BUDGET;
+	
+	while (g->rasterBytes > budget)
+	{
+		struct z64font_rasterSet *set;
+		struct z64font_rasterSet *worst = 0;
+		
+		for (set = g->rasterSet; set < g->rasterSet + Z64FONT_RASTER_SETS; ++set)
+		{
+			if (!set->raster || set->fontSize == g->fontSize)
+				continue;
+			if (!worst || abs(set->fontSize - g->fontSize)
+				> abs(worst->fontSize - g->fontSize)
+			)
+				worst = set;
+		}
+		
+		if (!worst)
+			break;
+		freeRasterSet(g, worst);
+	}
+}
+
+/* rasterize a zchar's glyph into a size's set, if not cached already */
+static struct z64font_raster *rasterize(
+	struct z64font *g
+	, struct z64font_rasterSet *set
+	, struct zchar *zchar
+)
+{
+	struct z64font_raster *r = set->raster + (zchar - g->zchar);
+	int n = set->oversample;
+	float scale = set->scale * n;
+	uint8_t *hi;
+	uint16_t *col = 0;
+	int lsb;
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+	
+	if (r->isReady)
+		return r;
+	
+	/* the fontinfo may have been copied from another z64font */
+	g->font.userdata = g;
+	
+	if (set->isSdf)
+	{
+		sdfRasterize(g, set, zchar, r);
+		goto L_done;
+	}
+	
+	/* same as stbtt_GetGlyphBitmap(), but into the set's slab */
+	stbtt_GetGlyphBitmapBox(&g->font, zchar->glyph, scale, scale, &x0, &y0, &x1, &y1);
+	r->x = floorDiv(x0, n);
+	r->y = floorDiv(y0, n);
+	r->w = x1 > x0 ? -floorDiv(-x1, n) - r->x : 0;
+	r->h = y1 > y0 ? -floorDiv(-y1, n) - r->y : 0;
+	if (r->w > 0 && r->h > 0
+		&& (r->bitmap = slabAlloc(g, &set->slab, r->w * r->h, SLAB_RASTER_MIN))
+	)
+	{
+		/* oversampled glyphs are drawn into cell-aligned scratch first */
+		hi = r->bitmap;
+		if (n > 1
+			&& (!(hi = slabAlloc(g, &g->scratch, r->w * r->h * n * n, SLAB_SCRATCH_MIN))
+				|| !(col = slabAlloc(g, &g->scratch, r->w * n * sizeof(*col), 0))
+			)
+		)
+			hi = 0;
+		
+		/* left blank should scratch run out partway */
+		if (!hi)
+			memset(r->bitmap, 0, r->w * r->h);
+		else
+		{
+			memset(hi, 0, r->w * r->h * n * n);
+			stbtt_MakeGlyphBitmap(
+				&g->font
+				, hi + (y0 - r->y * n) * r->w * n + (x0 - r->x * n)
+				, x1 - x0
+				, y1 - y0
+				, r->w * n
+				, scale
+				, scale
+				, zchar->glyph
+			);
+			if (n > 1)
+				boxFilter(r->bitmap, hi, r->w, r->h, n, col);
+		}
+	}
+	else /* blank, or out of memory */
+		r->w = r->h = 0;
+L_done:
+	scratchReset(g);
+	
+	stbtt_GetGlyphHMetrics(&g->font, zchar->glyph, &r->advance, &lsb);
+	r->isReady = 1;
+	STAT_ADD(g, glyphsRasterized, 1);
+	
+	set->bytes += r->w * r->h + sizeof(*r);
+	g->rasterBytes += r->w * r->h + sizeof(*r);
+	
+	return r;
+}
+
+/* stores 'width' as the big-endian f32 the game reads; the float's bits
+ * are copied out rather than read through a cast pointer, which breaks
+ * strict aliasing
+ */
+static void quickWidth(uint8_t *arr, float width)
+{
+	uint32_t widthU32;
+	
+	memcpy(&widthU32, &width, sizeof(widthU32));
+	arr[0] = widthU32 >> 24;
+	arr[1] = widthU32 >> 16;
+	arr[2] = widthU32 >> 8;
+	arr[3] = widthU32;
+}
+
+/* read file from drive; returns 0 on failure */
+static void *readFile(struct z64font *g, const char *fn, unsigned *sz)
+{
+	void *data;
+	unsigned sz_;
+	if (!sz)
+		sz = &sz_;
+	FILE *fp = fopen(fn, "rb");
+	if (!fp)
+	{
+		fail(g, "failed to open '%s' for reading", fn);
+		return 0;
+	}
+	
+	/* get file size */
+	fseek(fp, 0, SEEK_END);
+	*sz = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	
+	/* allocate memory to store file */
+	data = allocate(g, *sz+1);
+	if (!data)
+	{
+		fclose(fp);
+		return 0;
+	}
+	((char*)data)[*sz] = '\0'; /* in case used as string */
+	
+	/* doing it in a single read failed... */
+	if (fread(data, 1, *sz, fp) != *sz)
+	{
+		fclose(fp);
+		release(g, data, *sz+1);
+		fail(g, "failed to read file '%s'", fn);
+		return 0;
+	}
+	
+	fclose(fp);
+	return data;
+}
+
+/* read file from drive as string; returns 0 on failure */
+static char *readFileString(struct z64font *g, const char *fn)
+{
+	char *data;
+	unsigned dataSz;
+	data = readFile(g, fn, &dataSz);
+	if (!data)
+		return 0;
+	data[dataSz] = '\0';
+	return data;
+}
+
+/*
+ *
+ * public api
+ *
+ */
+
+
+/* strtok() without the hidden state, as exports may run on threads */
+static char *nextToken(char **s, const char *delim)
+{
+	char *tok = *s + strspn(*s, delim);
+	
+	if (!*tok)
+		return 0;
+	*s = tok + strcspn(tok, delim);
+	if (**s)
+		*(*s)++ = '\0';
+	
+	return tok;
+}
+
+static void statsMerge(struct z64font_stats *dst, const struct z64font_stats *src)
+{
+	int i;
+	
+	for (i = 0; i < Z64FONT_STAGE_NUM; ++i)
+	{
+		dst->wall[i] += src->wall[i];
+		dst->cpu[i] += src->cpu[i];
+	}
+	dst->bytesWritten += src->bytesWritten;
+	dst->filesWritten += src->filesWritten;
+	dst->filesUnchanged += src->filesUnchanged;
+	dst->allocations += src->allocations;
+	if (src->memPeak > dst->memPeak)
+		dst->memPeak = src->memPeak;
+}
+
+/* quantize every glyph once, for any number of targets to write; the
+ * width table needs no encoding, as convertOne() keeps it up to date;
+ * returns non-zero on failure
+ */
+static int encodeBinaries(struct z64font *g, uint8_t **i4)
+{
+	struct zchar *zchar;
+	struct quantizer q;
+	uint8_t *dst;
+	
+	if (!(*i4 = allocate(g, g->zcharNum * (FONT_W * FONT_H / 2) + 1)))
+		return -1;
+	
+	quantizerInit(&q, g);
+	for (zchar = g->zchar, dst = *i4; zchar < g->zchar + g->zcharNum; ++zchar)
+	{
+		struct stageClock t = stageBegin(g);
+		
+		/* bitmaps may be shared between slots, so never convert in place */
+		i8_to_i4(dst, zchar->bitmap, &q);
+		dst += FONT_W * FONT_H / 2;
+		stageEnd(g, Z64FONT_STAGE_QUANTIZE, t);
+	}
+	
+	return 0;
+}
+
+static void releaseBinaries(struct z64font *g, uint8_t *i4)
+{
+	release(g, i4, g->zcharNum * (FONT_W * FONT_H / 2) + 1);
+}
+
+/* whether 'fn' already holds exactly 'data' */
+static int isUnchanged(const char *fn, const void *data, size_t sz, int isText)
+{
+	FILE *fp = fopen(fn, isText ? "r" : "rb");
+	const uint8_t *d = data;
+	uint8_t buf[4096];
+	size_t n;
+	
+	if (!fp)
+		return 0;
+	while ((n = fread(buf, 1, sizeof(buf), fp)))
+	{
+		if (n > sz || memcmp(buf, d, n))
+			break;
+		d += n;
+		sz -= n;
+	}
+	fclose(fp);
+	
+	return !n && !sz;
+}
+
+/* write a whole file, unless skipUnchanged is set and it already holds
+ * 'data'; returns non-zero on failure
+ */
+static int writeFileMode(
+	struct z64font *g
+	, const char *fn
+	, const void *data
+	, size_t sz
+	, int isText
+)
+{
+	FILE *fp;
+	
+	if (g->skipUnchanged && isUnchanged(fn, data, sz, isText))
+	{
+		STAT_ADD(g, filesUnchanged, 1);
+		return 0;
+	}
+	
+	if (!(fp = fopen(fn, isText ? "w" : "wb")))
+	{
+		fail(g, "failed to open '%s' for writing\n", fn);
+		return -1;
+	}
+	if (writeBytes(g, data, sz, fp))
+	{
+		fail(g, "failed to write '%s'\n", fn);
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+	STAT_ADD(g, filesWritten, 1);
+	
+	return 0;
+}
+
+static int writeFile(struct z64font *g, const char *fn, const void *data, size_t sz)
+{
+	return writeFileMode(g, fn, data, sz, 0);
+}
+
+/* used when no profile is given; same as profiles/oot.ini */
+static const float defaultIconWidth[] = {
+	14.0f, // '[A]'
+	14.0f, // '[B]'
+	14.0f, // '[C]'
+	14.0f, // '[L]'
+	14.0f, // '[R]'
+	14.0f, // '[Z]'
+	14.0f, // '[C-Up]'
+	14.0f, // '[C-Down]'
+	14.0f, // '[C-Left]'
+	14.0f, // '[C-Right]'
+	14.0f, // '▼'
+	14.0f, // '[Control-Pad]'
+	14.0f, // '[D-Pad]'
+	14.0f, // ?
+	14.0f, // ?
+	14.0f, // ?
+	14.0f, // ?
+};
+static const struct z64font_target defaultTarget = {
+	.name = "oot-decomp"
+	, .isDecomp = 1
+	, .slots = 140
+	, .cellW = FONT_W
+	, .cellH = FONT_H
+	, .iconWidth = defaultIconWidth
+	, .iconNum = sizeof(defaultIconWidth) / sizeof(*defaultIconWidth)
+};
+
+/* writes the pngs named by decompFileNames and 'fn'; 0 on success */
+static int writeDecomp(struct z64font *g, const char *fn)
+{
+	int rval = -1;
+	struct zchar *zchar;
+	const char *delim = "\r\n";
+	char *pngFn = 0;
+	char *decompFileNames = strdup(g->decompFileNames);
+	char *tok = decompFileNames;
+	unsigned char rgbaBuf[FONT_W * FONT_H][4];
+	const struct z64font_target *target = g->target ? g->target : &defaultTarget;
+	char *widths = 0;
+	size_t widthsMax = (g->zcharNum + target->iconNum) * 64;
+	size_t widthsSz = 0;
+	
+	if (!fn || !decompFileNames)
+		goto L_cleanup;
+	
+	/* finish any glyphs a lazy conversion has yet to get to */
+	if (z64font_convertNext(g, g->zcharNum) < 0)
+		goto L_cleanup;
+
+	pngFn = nextToken(&tok, delim);
+
+	for (zchar = g->zchar; zchar < g->zchar + g->zcharNum && pngFn; ++zchar)
+	{
+		struct stageClock t = stageBegin(g);
+		unsigned char *png;
+		int pngSz;
+		
+		/* convert i8 to rgba32 */
+		for (int i = 0; i < FONT_W * FONT_H; ++i)
+		{
+			rgbaBuf[i][0] = rgbaBuf[i][1] = rgbaBuf[i][2] = ((unsigned char *)zchar->bitmap)[i]; /* rgb */
+			rgbaBuf[i][3] = 255; /* a */
+		}
+		png = stbi_write_png_to_mem((void*)rgbaBuf, FONT_W * 4, FONT_W, FONT_H, 4, &pngSz);
+		stageEnd(g, Z64FONT_STAGE_ENCODE, t);
+		STAT_ADD(g, allocations, 1);
+		if (!png)
+		{
+			fail(g, "memory error");
+			goto L_cleanup;
+		}
+		if (writeFile(g, pngFn, png, pngSz))
+		{
+			free(png);
+			goto L_cleanup;
+		}
+		free(png);
+		pngFn = nextToken(&tok, delim);
+	}
+
+	/* export 'comic-sans.font_width.h' */
+	if (!(widths = allocate(g, widthsMax)))
+		goto L_cleanup;
+	for (unsigned i = 0; i < g->zcharNum + target->iconNum; ++i)
+	{
+		struct stageClock t = stageBegin(g);
+		int lineSz;
+		
+		lineSz = snprintf(widths + widthsSz, 64, "%ff,\n"
+			, i < g->zcharNum
+				? g->zchar[i].width
+				: target->iconWidth[i - g->zcharNum]
+		);
+		stageEnd(g, Z64FONT_STAGE_ENCODE, t);
+		if (lineSz < 0 || lineSz >= 64)
+		{
+			fail(g, "failed to write '%s'\n", fn);
+			goto L_cleanup;
+		}
+		widthsSz += lineSz;
+	}
+	if (writeFileMode(g, fn, widths, widthsSz, 1))
+		goto L_cleanup;
+	rval = 0;
+L_cleanup:
+	free(decompFileNames);
+	release(g, widths, widthsMax);
+	return rval;
+}
+
+int z64font_exportDecomp(struct z64font *g, char **ofn)
+{
+	if (!ofn || !*ofn || writeDecomp(g, *ofn))
+		return -1;
+	
+	inform(g, "Export successful!\n");
+	return 0;
+}
+
+int z64font_exportBinaries(struct z64font *g, char **ofn)
+{
+	uint8_t *i4;
+	int rval = -1;
+	
+	if (!ofn || !*ofn)
+		return -1;
+	
+	/* finish any glyphs a lazy conversion has yet to get to */
+	if (z64font_convertNext(g, g->zcharNum) < 0 || encodeBinaries(g, &i4))
+		return -1;
+	
+	/* export 'comic-sans.font_static' and 'comic-sans.width_table' */
+	if (wow_fnChangeExtension(ofn, "font_static"))
+		fail(g, "memory error");
+	else if (!writeFile(g, *ofn, i4, g->zcharNum * (FONT_W * FONT_H / 2)))
+	{
+		if (wow_fnChangeExtension(ofn, "width_table"))
+			fail(g, "memory error");
+		else if (!writeFile(g, *ofn, g->widthTableBe, g->zcharNum * 4))
+		{
+			inform(g, "Export successful!\n");
+			rval = 0;
+		}
+	}
+	
+	releaseBinaries(g, i4);
+	return rval;
+}
+
+/* one target's writer; works on a copy of the z64font so that stats
+ * and lazy conversion state are never shared between threads
+ */
+struct targetJob
+{
+	struct z64font g;
+	struct z64font_stats stats;
+	const struct z64font_target *target;
+	const char *base;
+	const uint8_t *i4;
+	int failed;
+	pthread_t tid;
+	int isThread;
+};
+
+static void *targetThreadFunc(void *udata)
+{
+	struct targetJob *job = udata;
+	const struct z64font_target *t = job->target;
+	struct z64font *g = &job->g;
+	size_t fnSz = strlen(job->base) + strlen(t->name) + 32;
+	char *fn = allocate(g, fnSz);
+	const uint8_t *widths = g->widthTableBe;
+	uint8_t *le = 0;
+	char offsets[256];
+	int offsetsSz;
+	
+	if (!fn)
+	{
+		job->failed = 1;
+		return 0;
+	}
+	
+	if (t->isDecomp)
+	{
+		sprintf(fn, "%s.font_width.h", job->base);
+		job->failed = writeDecomp(g, fn);
+		release(g, fn, fnSz);
+		return 0;
+	}
+	
+	/* where each file goes, for those injecting them by hand */
+	offsetsSz = snprintf(offsets, sizeof(offsets)
+		, "font_static 0x%08X\nwidth_table 0x%08X\n"
+		, t->fontStatic
+		, t->widthTable[0]
+	);
+	if (t->widthTable[1])
+		offsetsSz += snprintf(offsets + offsetsSz, sizeof(offsets) - offsetsSz
+			, "width_table 0x%08X\n"
+			, t->widthTable[1]
+		);
+	
+	/* widths are encoded big endian; swap them for targets that aren't */
+	if (t->isLittleEndian)
+	{
+		struct stageClock c = stageBegin(g);
+		
+		if (!(le = allocate(g, g->zcharNum * 4 + 1)))
+		{
+			job->failed = 1;
+			release(g, fn, fnSz);
+			return 0;
+		}
+		z64font_bswap32(le, widths, g->zcharNum);
+		widths = le;
+		stageEnd(g, Z64FONT_STAGE_ENCODE, c);
+	}
+	
+	sprintf(fn, "%s.%s.font_static", job->base, t->name);
+	job->failed = writeFile(g, fn, job->i4, g->zcharNum * (FONT_W * FONT_H / 2));
+	sprintf(fn, "%s.%s.width_table", job->base, t->name);
+	job->failed = job->failed || writeFile(g, fn, widths, g->zcharNum * 4);
+	sprintf(fn, "%s.%s.offsets", job->base, t->name);
+	job->failed = job->failed || writeFile(g, fn, offsets, offsetsSz);
+	
+	release(g, le, g->zcharNum * 4 + 1);
+	release(g, fn, fnSz);
+	return 0;
+}
+
+/* names are 'base.target.font_static' etc; decomp targets write the
+ * pngs named by decompFileNames and 'base.font_width.h'
+ */
+int z64font_exportTargets(
+	struct z64font *g
+	, const struct z64font_target **target
+	, int targetNum
+	, const char *base
+)
+{
+	struct targetJob *job;
+	uint8_t *i4;
+	int failed = 0;
+	int i;
+	
+	/* glyphs are rasterized for one cell size, so every target must agree */
+	for (i = 0; i < targetNum; ++i)
+	{
+		const struct z64font_target *t = target[i];
+		
+		if (t->cellW != FONT_W || t->cellH != FONT_H)
+		{
+			fail(g, "target '%s' uses %dx%d cells; only %dx%d are supported\n"
+				, t->name, t->cellW, t->cellH, FONT_W, FONT_H
+			);
+			return -1;
+		}
+		if ((int)g->zcharNum > t->slots)
+		{
+			fail(g, "target '%s' has room for %d glyphs, not %u\n"
+				, t->name, t->slots, g->zcharNum
+			);
+			return -1;
+		}
+	}
+	
+	/* one conversion and one encoding are shared by every target */
+	if (z64font_convertNext(g, g->zcharNum) < 0 || encodeBinaries(g, &i4))
+		return -1;
+	
+	if (!(job = allocate(g, targetNum * sizeof(*job))))
+	{
+		releaseBinaries(g, i4);
+		return -1;
+	}
+	memset(job, 0, targetNum * sizeof(*job));
+	for (i = 0; i < targetNum; ++i)
+	{
+		job[i].g = *g;
+		job[i].g.info = 0;
+		job[i].g.error = 0;
+		job[i].g.target = target[i];
+		job[i].g.stats = g->stats ? &job[i].stats : 0;
+		job[i].target = target[i];
+		job[i].base = base;
+		job[i].i4 = i4;
+		job[i].isThread = !pthread_create(&job[i].tid, 0, targetThreadFunc, &job[i]);
+		if (!job[i].isThread)
+			targetThreadFunc(&job[i]);
+	}
+	
+	for (i = 0; i < targetNum; ++i)
+	{
+		if (job[i].isThread)
+			pthread_join(job[i].tid, 0);
+		if (g->stats)
+			statsMerge(g->stats, &job[i].stats);
+		/* jobs report nothing themselves; do it from this thread */
+		if (job[i].failed)
+			fail(g, "%s\n", job[i].g.lastError);
+		failed |= job[i].failed;
+	}
+	
+	release(g, job, targetNum * sizeof(*job));
+	releaseBinaries(g, i4);
+	
+	if (!failed)
+		inform(g, "Export successful!\n");
+	return failed ? -1 : 0;
+}
+
+/* convert one codepoint's glyph, if it hasn't been already */
+static void convertOne(struct z64font *g, struct zchar *zchar)
+{
+	int width;
+	uint8_t conv[FONT_W * FONT_H];
+	uint8_t *pool = g->glyphPool;
+	unsigned short *hashTab = g->glyphHash;
+	struct zchar *arr = g->zchar;
+	struct z64font_raster blank = {0};
+	struct z64font_raster *r = &blank;
+	struct z64font_rasterSet *set;
+	float scale = g->scale;
+	unsigned slot;
+	struct stageClock t;
+	
+	if (zchar->bitmap)
+		return;
+	
+	STAT_ADD(g, glyphs, 1);
+	
+	/* codepoints sharing a glyph (.notdef etc) share its result */
+	if (zchar->first != zchar - arr)
+	{
+		convertOne(g, arr + zchar->first);
+		zchar->bitmap = arr[zchar->first].bitmap;
+		zchar->width = arr[zchar->first].width;
+		memcpy(g->widthTableBe + 4 * (zchar - arr), g->widthTableBe + 4 * zchar->first, 4);
+		zchar->inkX0 = arr[zchar->first].inkX0;
+		zchar->inkY0 = arr[zchar->first].inkY0;
+		zchar->inkX1 = arr[zchar->first].inkX1;
+		zchar->inkY1 = arr[zchar->first].inkY1;
+		zchar->clipped = arr[zchar->first].clipped;
+		g->convertLeft -= 1;
+		STAT_ADD(g, shared, 1);
+		return;
+	}
+	
+	/* rasterizing is the slow part, so reuse it across conversions */
+	t = stageBegin(g);
+	if ((set = rasterSetFor(g, g->fontSize, 1)))
+	{
+		STAT_ADD(g, rasterHits, set->raster[zchar - arr].isReady);
+		STAT_ADD(g, rasterMisses, !set->raster[zchar - arr].isReady);
+		r = rasterize(g, set, zchar);
+	}
+	t = stageEnd(g, Z64FONT_STAGE_RASTERIZE, t);
+	
+	//fprintf(stderr, "xofs yofs %d %d\n", r->x, r->y);
+	//fprintf(stderr, "baseline = %d\n", g->baseline);
+	
+	compose(r->x, g->baseline + r->y, r->w, r->h, r->bitmap, conv, g->yshift, zchar);
+	t = stageEnd(g, Z64FONT_STAGE_COMPOSE, t);
+	
+	if (g->widthAdvance)
+		width = r->advance * scale;
+	else
+		width = fmax(r->w, r->advance * scale);
+	
+	width += g->xPad;
+	
+	zchar->width = width;
+	quickWidth(g->widthTableBe + 4 * (zchar - arr), width);
+	stageEnd(g, Z64FONT_STAGE_WIDTH, t);
+	
+	/* distinct glyphs that compose identically share one bitmap */
+	for (slot = hashBitmap(conv) % (ZCHAR_MAX * 2)
+		; hashTab[slot]
+		; slot = (slot + 1) % (ZCHAR_MAX * 2)
+	)
+	{
+		uint8_t *b = pool + (hashTab[slot] - 1) * sizeof(conv);
+		if (!memcmp(b, conv, sizeof(conv)))
+			break;
+	}
+	if (!hashTab[slot])
+	{
+		memcpy(pool + g->glyphPoolNum * sizeof(conv), conv, sizeof(conv));
+		hashTab[slot] = ++g->glyphPoolNum;
+	}
+	zchar->bitmap = pool + (hashTab[slot] - 1) * sizeof(conv);
+	g->convertLeft -= 1;
+}
+
+int z64font_resolve(struct z64font *g)
+{
+	struct stageClock t;
+	
+	/* get codepoints and walk the cmap only when font or chars change */
+	if (g->isResolved)
+		return 0;
+	
+	t = stageBegin(g);
+	if (resolveGlyphs(g, 0))
+		return -1;
+	stageEnd(g, Z64FONT_STAGE_PARSE, t);
+	
+	return 0;
+}
+
+int z64font_convertBegin(struct z64font *g)
+{
+	struct zchar *zchar;
+	stbtt_fontinfo *font = &g->font;
+	int ascent;
+	
+	g->isOverBudget = 0;
+	g->scale = stbtt_ScaleForPixelHeight(font, g->fontSize);
+	stbtt_GetFontVMetrics(font, &ascent, 0, 0);
+	g->baseline = g->scale * ascent;
+	
+	if (z64font_resolve(g))
+		return -1;
+	
+	if (!g->glyphPool
+		&& !(g->glyphPool = allocate(g, ZCHAR_MAX * FONT_W * FONT_H))
+	)
+		return -1;
+	if (!g->glyphHash
+		&& !(g->glyphHash = allocate(g, ZCHAR_MAX * 2 * sizeof(*g->glyphHash)))
+	)
+		return -1;
+	if (!g->widthTableBe && !(g->widthTableBe = allocate(g, ZCHAR_MAX * 4)))
+		return -1;
+	memset(g->glyphHash, 0, ZCHAR_MAX * 2 * sizeof(*g->glyphHash));
+	g->glyphPoolNum = 0;
+	
+	/* nothing converted yet */
+	for (zchar = g->zchar; zchar < g->zchar + g->zcharNum; ++zchar)
+		zchar->bitmap = 0;
+	g->convertNext = 0;
+	g->convertLeft = g->zcharNum;
+	
+	trimRasters(g);
+	
+	return 0;
+}
+
+int z64font_convertCodepoints(struct z64font *g, const char *str)
+{
+	const char *next;
+	const char *w;
+	
+	for (w = str; *w && *w != 0x0d && *w != 0x0a; w = next)
+	{
+		utf8_int32_t codepoint;
+		struct zchar *zchar;
+		
+		next = utf8codepoint(w, &codepoint);
+		
+		zchar = (struct zchar*)zchar_findCodepoint(g->zchar, g->zcharNum, codepoint);
+		if (zchar)
+			convertOne(g, zchar);
+	}
+	
+	return g->isOverBudget ? -1 : g->convertLeft;
+}
+
+int z64font_convertNext(struct z64font *g, int max)
+{
+	struct zchar *zchar;
+	
+	for (zchar = g->zchar + g->convertNext
+		; max > 0 && zchar < g->zchar + g->zcharNum
+		; ++zchar
+	)
+	{
+		if (zchar->bitmap)
+			continue;
+		convertOne(g, zchar);
+		--max;
+	}
+	g->convertNext = zchar - g->zchar;
+	
+	return g->isOverBudget ? -1 : g->convertLeft;
+}
+
+int z64font_rasterizeNext(struct z64font *g, int fontSize, int max)
+{
+	struct z64font_rasterSet *set;
+	struct zchar *zchar;
+	size_t budget = g->rasterBudget ? g->rasterBudget : Z64FONT_RASTER_BUDGET;
+	
+	/* speculative work stops once the budget is reached */
+	if (!g->isResolved || fontSize < 1)
+		return 0;
+	if (!(set = rasterSetFor(g, fontSize, 0)))
+	{
+		if (g->rasterBytes >= budget || !(set = rasterSetFor(g, fontSize, 1)))
+			return 0;
+	}
+	
+	for (zchar = g->zchar + set->next
+		; zchar < g->zchar + g->zcharNum
+		; ++zchar
+	)
+	{
+		if (g->rasterBytes >= budget || max-- <= 0)
+			break;
+		if (zchar->first == zchar - g->zchar)
+			rasterize(g, set, zchar);
+	}
+	set->next = zchar - g->zchar;
+	
+	if (g->rasterBytes >= budget)
+		return 0;
+	
+	return g->zcharNum - set->next;
+}
+
+void z64font_flushRasters(struct z64font *g)
+{
+	struct z64font_rasterSet *set;
+	
+	for (set = g->rasterSet; set < g->rasterSet + Z64FONT_RASTER_SETS; ++set)
+		freeRasterSet(g, set);
+	slabFree(g, &g->scratch);
+	slabFree(g, &g->sdfSlab);
+	release(g, g->sdf, ZCHAR_MAX * sizeof(*g->sdf));
+	g->sdf = 0;
+}
+
+void z64font_bswap32(void *dst, const void *src, size_t num)
+{
+	const uint8_t *s = src;
+	uint8_t *d = dst;
+	size_t i;
+	
+	/* two entries at a time, each 32-bit half of a 64-bit word reversed
+	 * in place, which is right whatever the host's byte order; words are
+	 * read whole before being written, so dst may be src
+	 */
+	for (i = 0; i + 2 <= num; i += 2, s += 8, d += 8)
+	{
+		uint64_t v;
+		
+		memcpy(&v, s, 8);
+		v = ((v & 0x00ff00ff00ff00ffull) << 8) | ((v >> 8) & 0x00ff00ff00ff00ffull);
+		v = ((v & 0x0000ffff0000ffffull) << 16) | ((v >> 16) & 0x0000ffff0000ffffull);
+		memcpy(d, &v, 8);
+	}
+	
+	if (i < num)
+	{
+		uint8_t b[4] = { s[3], s[2], s[1], s[0] };
+		
+		memcpy(d, b, 4);
+	}
+}
+
+/* copies a string into memory accounted to 'g' */
+static char *copyString(struct z64font *g, const char *str)
+{
+	char *copy;
+	
+	if (!str || !(copy = allocate(g, strlen(str) + 1)))
+		return 0;
+	
+	return strcpy(copy, str);
+}
+
+int z64font_share(struct z64font *dst, const struct z64font *src)
+{
+	unsigned i;
+	
+	*dst = (struct z64font){
+		.ttfBin = src->ttfBin
+		, .ttfBinSz = src->ttfBinSz
+		, .font = src->font
+		, .fontSize = src->fontSize
+		, .yshift = src->yshift
+		, .xPad = src->xPad
+		, .rightToLeft = src->rightToLeft
+		, .widthAdvance = src->widthAdvance
+		, .oversample = src->oversample
+		, .isSdf = src->isSdf
+		, .weight = src->weight
+		, .quantizer = src->quantizer
+		, .gamma = src->gamma
+		, .contrast = src->contrast
+		, .isDecompMode = src->isDecompMode
+		, .target = src->target
+		, .zcharNum = src->zcharNum
+		, .rasterBudget = src->rasterBudget
+		, .memBudget = src->memBudget
+		, .isResolved = src->isResolved
+		, .isFontShared = 1
+		, .info = src->info
+		, .error = src->error
+		, .udata = src->udata
+	};
+	
+	/* zchar[] is freed, not released, like one the caller allocated */
+	if (!(dst->zchar = calloc(ZCHAR_MAX, sizeof(*dst->zchar))))
+	{
+		fail(dst, "memory error");
+		dst->zcharNum = 0;
+		return -1;
+	}
+	
+	/* codepoints stay mapped to glyphs; the glyphs themselves are src's */
+	if (src->zchar)
+		memcpy(dst->zchar, src->zchar, src->zcharNum * sizeof(*dst->zchar));
+	for (i = 0; i < dst->zcharNum; ++i)
+		dst->zchar[i].bitmap = 0;
+	
+	if ((src->chars && !(dst->chars = copyString(dst, src->chars)))
+		|| (src->decompFileNames
+			&& !(dst->decompFileNames = copyString(dst, src->decompFileNames))
+		)
+	)
+	{
+		z64font_free(dst);
+		return -1;
+	}
+	
+	return 0;
+}
+
+void z64font_free(struct z64font *g)
+{
+	z64font_flushRasters(g);
+	if (!g->isFontShared)
+		release(g, g->ttfBin, g->ttfBinSz + 1);
+	if (g->chars)
+		release(g, g->chars, strlen(g->chars) + 1);
+	if (g->decompFileNames)
+		release(g, g->decompFileNames, strlen(g->decompFileNames) + 1);
+	release(g, g->glyphPool, ZCHAR_MAX * FONT_W * FONT_H);
+	release(g, g->glyphHash, ZCHAR_MAX * 2 * sizeof(*g->glyphHash));
+	release(g, g->widthTableBe, ZCHAR_MAX * 4);
+	free(g->zchar);
+	
+	g->ttfBin = 0;
+	g->chars = 0;
+	g->decompFileNames = 0;
+	g->glyphPool = 0;
+	g->glyphHash = 0;
+	g->widthTableBe = 0;
+	g->zchar = 0;
+	g->zcharNum = 0;
+	g->isResolved = 0;
+}
+
+int z64font_convert(struct z64font *g)
+{
+	if (z64font_convertBegin(g))
+		return -1;
+	
+	return z64font_convertNext(g, g->zcharNum) < 0 ? -1 : 0;
+}
+
+/* stb_truetype trusts offsets it reads from the file, so a file that
+ * is cut short (caught mid-save, say) must be turned away beforehand
+ */
+static int isTruncatedFont(const uint8_t *b, unsigned sz)
+{
+	unsigned num;
+	unsigned i;
+	
+	if (sz < 12)
+		return 1;
+	
+	num = (b[4] << 8) | b[5];
+	if (sz < 12 + num * 16)
+		return 1;
+	
+	/* every table in the directory must be within the file */
+	for (i = 0; i < num; ++i)
+	{
+		const uint8_t *rec = b + 12 + i * 16;
+		uint32_t ofs = (uint32_t)rec[8] << 24 | rec[9] << 16 | rec[10] << 8 | rec[11];
+		uint32_t len = (uint32_t)rec[12] << 24 | rec[13] << 16 | rec[14] << 8 | rec[15];
+		
+		if (ofs > sz || len > sz - ofs)
+			return 1;
+	}
+	
+	return 0;
+}
+
+int z64font_loadFont(struct z64font *g, const char *fn)
+{
+	struct stageClock t;
+	
+	/* ttf changed */
+	if (!g->isFontShared)
+		release(g, g->ttfBin, g->ttfBinSz + 1);
+	g->ttfBin = 0;
+	g->isFontShared = 0;
+	g->isResolved = 0;
+	g->isOverBudget = 0;
+	
+	if (!fn || !strlen(fn))
+		return 1;
+	
+	t = stageBegin(g);
+	if (!(g->ttfBin = readFile(g, fn, &g->ttfBinSz)))
+		return 1;
+	
+	if (isTruncatedFont(g->ttfBin, g->ttfBinSz)
+		|| !stbtt_InitFont(&g->font, g->ttfBin, 0)
+	)
+	{
+		release(g, g->ttfBin, g->ttfBinSz + 1);
+		g->ttfBin = 0;
+		fail(g, "unsupported font file '%s'", fn);
+		return 1;
+	}
+	stageEnd(g, Z64FONT_STAGE_LOAD, t);
+	return 0;
+}
+
+int z64font_loadCodepoints(struct z64font *g, const char *fn)
+{
+	struct stageClock t;
+	int wasResolved = g->isResolved;
+	
+	/* txt changed */
+	if (g->chars)
+		release(g, g->chars, strlen(g->chars) + 1);
+	g->chars = 0;
+	g->isResolved = 0;
+	g->isOverBudget = 0;
+	
+	if (!fn || !strlen(fn))
+		return 1;
+	
+	/* read characters as string */
+	t = stageBegin(g);
+	if (!(g->chars = readFileString(g, fn)))
+		return 1;
+	stageEnd(g, Z64FONT_STAGE_LOAD, t);
+	
+	if (utf8valid(g->chars))
+	{
+		fail(g, "'%s' contains invalid codepoint(s)", fn);
+		return 1;
+	}
+	
+	/* same font as before, so its rasters needn't be made again */
+	if (wasResolved)
+	{
+		t = stageBegin(g);
+		if (resolveGlyphs(g, 1))
+			return 1;
+		stageEnd(g, Z64FONT_STAGE_PARSE, t);
+	}
+	
+	return 0;
+}
+
+int z64font_loadDecompFileNames(struct z64font *g, const char *fn)
+{
+	struct stageClock t;
+	
 	/* txt changed */
 	if (g->decompFileNames)
-		free(g->decompFileNames);
+		release(g, g->decompFileNames, strlen(g->decompFileNames) + 1);
+	g->decompFileNames = 0;
+	g->isOverBudget = 0;
 	
 	if (!fn || !strlen(fn))
 		return 1;
 	
 	/* read characters as string */
+	t = stageBegin(g);
 	if (!(g->decompFileNames = readFileString(g, fn)))
 		return 1;
+	stageEnd(g, Z64FONT_STAGE_LOAD, t);
+
+	return 0;
+}
+
+/* number of hardware threads worth spreading work across */
+int z64font_threadCount(void)
+{
+	int num = 1;
+	
+#if defined(_WIN32)
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	num = info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+	num = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	
+	return num < 1 ? 1 : num;
+}
+
+void z64font_stderr(void *udata, const char *fmt, ...)
+{
+	va_list ap;
+	
+	(void)udata;
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+}
+
+/* monotonic wall clock, in seconds */
+double z64font_seconds(void)
+{
+#ifdef _WIN32
+	LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+	
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return (double)now.QuadPart / freq.QuadPart;
+#else
+	struct timespec ts;
+	
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
 
+const char *z64font_stageName(enum z64font_stage stage)
+{
+	static const char *names[Z64FONT_STAGE_NUM] = {
+		[Z64FONT_STAGE_LOAD] = "load"
+		, [Z64FONT_STAGE_PARSE] = "parse"
+		, [Z64FONT_STAGE_RASTERIZE] = "rasterize"
+		, [Z64FONT_STAGE_COMPOSE] = "compose"
+		, [Z64FONT_STAGE_WIDTH] = "width"
+		, [Z64FONT_STAGE_QUANTIZE] = "quantize"
+		, [Z64FONT_STAGE_ENCODE] = "encode"
+		, [Z64FONT_STAGE_WRITE] = "write"
+	};
+	
+	if (stage < 0 || stage >= Z64FONT_STAGE_NUM)
+		return "unknown";
+	return names[stage];
+}
+
+/* one line of ink bounds per glyph, then a summary; the bounds are in
+ * cell pixels, so any outside 0,0-FONT_W,FONT_H mean clipping; returns
+ * the number of glyphs that clip, or -1 on write failure
+ */
+int z64font_writeClipReport(struct z64font *g, FILE *fp)
+{
+	struct zchar *zchar;
+	unsigned long pixels = 0;
+	int clipping = 0;
+	
+	/* finish any glyphs a lazy conversion has yet to get to */
+	if (z64font_convertNext(g, g->zcharNum) < 0)
+		return -1;
+	
+	for (zchar = g->zchar; zchar < g->zchar + g->zcharNum; ++zchar)
+	{
+		if (fprintf(fp, "codepoint=U+%04X ink=%d,%d,%d,%d clipped=%d\n"
+			, zchar->codepoint
+			, zchar->inkX0
+			, zchar->inkY0
+			, zchar->inkX1
+			, zchar->inkY1
+			, zchar->clipped
+		) < 0)
+			return -1;
+		
+		clipping += zchar->clipped > 0;
+		pixels += zchar->clipped;
+	}
+	
+	if (fprintf(fp, "glyphs=%u clipping=%d clipped_pixels=%lu\n"
+		, g->zcharNum
+		, clipping
+		, pixels
+	) < 0)
+		return -1;
+	
+	return clipping;
+}
+
+const char *z64font_quantizerName(enum z64font_quantizer quantizer)
+{
+	static const char *names[Z64FONT_QUANTIZE_NUM] = {
+		[Z64FONT_QUANTIZE_NEAREST] = "nearest"
+		, [Z64FONT_QUANTIZE_BAYER] = "bayer"
+		, [Z64FONT_QUANTIZE_FLOYD_STEINBERG] = "floyd"
+		, [Z64FONT_QUANTIZE_ATKINSON] = "atkinson"
+	};
+	
+	if (quantizer < 0 || quantizer >= Z64FONT_QUANTIZE_NUM)
+		return "unknown";
+	return names[quantizer];
+}
+
+/* dump stats as a json object; returns non-zero on write failure */
+int z64font_writeStatsJson(const struct z64font_stats *stats, FILE *fp)
+{
+	int i;
+	
+	if (fprintf(fp, "{\n\t\"stages\": {\n") < 0)
+		return -1;
+	for (i = 0; i < Z64FONT_STAGE_NUM; ++i)
+	{
+		if (fprintf(fp, "\t\t\"%s\": { \"wall\": %.9f, \"cpu\": %.9f }%s\n"
+			, z64font_stageName(i)
+			, stats->wall[i]
+			, stats->cpu[i]
+			, i + 1 < Z64FONT_STAGE_NUM ? "," : ""
+		) < 0)
+			return -1;
+	}
+	if (fprintf(fp
+		, "\t},\n"
+		"\t\"glyphs\": %u,\n"
+		"\t\"shared\": %u,\n"
+		"\t\"rasterHits\": %u,\n"
+		"\t\"rasterMisses\": %u,\n"
+		"\t\"glyphsRasterized\": %u,\n"
+		"\t\"bytesWritten\": %llu,\n"
+		"\t\"filesWritten\": %u,\n"
+		"\t\"filesUnchanged\": %u,\n"
+		"\t\"allocations\": %llu,\n"
+		"\t\"memPeak\": %llu\n"
+		"}\n"
+		, stats->glyphs
+		, stats->shared
+		, stats->rasterHits
+		, stats->rasterMisses
+		, stats->glyphsRasterized
+		, stats->bytesWritten
+		, stats->filesWritten
+		, stats->filesUnchanged
+		, stats->allocations
+		, stats->memPeak
+	) < 0)
+		return -1;
+	
 	return 0;
 }
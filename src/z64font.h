@@ -15,9 +15,112 @@
 #define  PROG_NAME_VER_ATTRIB    PROGNAME" "PROGVER" "PROGATTRIB
 #define  ZCHAR_MAX 4096   /* 4096 character slots is plenty */
 
+#define  Z64FONT_RASTER_SETS 8              /* sizes kept rasterized */
+#define  Z64FONT_RASTER_BUDGET (32 << 20)   /* default cache byte cap */
+#define  Z64FONT_OVERSAMPLE_MAX 8
+#define  Z64FONT_SDF_SIZE 64      /* pixel height distance fields are made at */
+#define  Z64FONT_WEIGHT_MAX 10    /* weight is in tenths of a pixel */
+
+#include <stdio.h>
+#include <stddef.h>
 #include "zchar.h"
 #include "stb_truetype.h"
 
+/* pipeline stages timed when a z64font has stats attached */
+enum z64font_stage
+{
+	Z64FONT_STAGE_LOAD
+	, Z64FONT_STAGE_PARSE
+	, Z64FONT_STAGE_RASTERIZE
+	, Z64FONT_STAGE_COMPOSE
+	, Z64FONT_STAGE_WIDTH
+	, Z64FONT_STAGE_QUANTIZE
+	, Z64FONT_STAGE_ENCODE
+	, Z64FONT_STAGE_WRITE
+	, Z64FONT_STAGE_NUM
+};
+
+/* how i8 glyphs are reduced to the game's i4 */
+enum z64font_quantizer
+{
+	Z64FONT_QUANTIZE_NEAREST
+	, Z64FONT_QUANTIZE_BAYER
+	, Z64FONT_QUANTIZE_FLOYD_STEINBERG
+	, Z64FONT_QUANTIZE_ATKINSON
+	, Z64FONT_QUANTIZE_NUM
+};
+
+/* something exported to: one game version's font layout and where its
+ * files get injected; normally loaded from profiles/ (see profile.h)
+ */
+struct z64font_target
+{
+	const char *name;
+	int isDecomp;       /* pngs and font_width.h instead of binaries */
+	int isLittleEndian; /* width table byte order */
+	int slots;          /* glyphs font_static has room for */
+	int cellW;          /* glyph cell, in pixels */
+	int cellH;
+	const float *iconWidth; /* fixed widths of the slots after the glyphs */
+	int iconNum;
+	unsigned fontStatic;
+	unsigned widthTable[2]; /* mm keeps a second copy; 0 = unused */
+};
+
+/* accumulated by the z64font functions; clear it between runs */
+struct z64font_stats
+{
+	double wall[Z64FONT_STAGE_NUM]; /* seconds */
+	double cpu[Z64FONT_STAGE_NUM];  /* seconds, calling thread only */
+	unsigned glyphs;       /* zchars converted */
+	unsigned shared;       /* of those, reusing another zchar's bitmap */
+	unsigned rasterHits;   /* raster cache lookups */
+	unsigned rasterMisses;
+	unsigned glyphsRasterized; /* includes speculative rasterization */
+	unsigned long long bytesWritten;
+	unsigned filesWritten;
+	unsigned filesUnchanged; /* left alone, see skipUnchanged */
+	unsigned long long allocations;
+	unsigned long long memPeak; /* most bytes held at once during the run */
+};
+
+/* a glyph rasterized at some size, before composition into a cell */
+struct z64font_raster
+{
+	void *bitmap;
+	int x;
+	int y;
+	int w;
+	int h;
+	int advance;
+	char isReady;
+};
+
+/* a glyph's signed distance field, made once and reused at every size */
+struct z64font_sdf
+{
+	unsigned char *field;
+	int x;
+	int y;
+	int w;
+	int h;
+	char isReady;
+};
+
+/* every unique glyph rasterized at one size, indexed like zchar[] */
+struct z64font_rasterSet
+{
+	int fontSize;
+	int oversample;
+	int isSdf;
+	int weight;
+	float scale;
+	size_t bytes;
+	unsigned next; /* zchar[] index speculative rasterization resumes at */
+	struct z64font_raster *raster;
+	struct z64font_slab *slab; /* raster[].bitmap are carved from these */
+};
+
 struct z64font
 {
 	void *ttfBin;
@@ -30,26 +133,96 @@ struct z64font
 	int xPad;
 	int rightToLeft;
 	int widthAdvance;
+	int oversample;  /* rasterize this many times larger, then box filter */
+	int isSdf;       /* reconstruct glyphs from distance fields instead */
+	int weight;      /* sdf only; edges move outward this many tenths of px */
+	enum z64font_quantizer quantizer;
+	float gamma;     /* applied before quantizing; > 1 brightens, 0 = 1 */
+	float contrast;  /* about mid gray, after gamma; 0 = 1 */
 	int isDecompMode;
-	struct zchar *zchar;
+	const struct z64font_target *target; /* icon widths; 0 = oot's */
+	struct zchar *zchar; /* ZCHAR_MAX of them; allocated on use if 0 */
 	unsigned zcharNum;
-	char isI4;
-	void (*info)(const char *fmt, ...);
-	void (*error)(const char *fmt, ...);
+	void *glyphPool; /* unique i8 bitmaps; zchar[].bitmap points here */
+	unsigned glyphPoolNum;
+	unsigned short *glyphHash; /* glyphPool lookup by bitmap hash */
+	unsigned char *widthTableBe; /* zchar[].width as the game's be f32s */
+	float scale;       /* set by z64font_convertBegin() */
+	int baseline;
+	unsigned convertNext; /* zchar[] index lazy conversion resumes at */
+	int convertLeft;      /* zchars yet to be converted */
+	struct z64font_rasterSet rasterSet[Z64FONT_RASTER_SETS];
+	size_t rasterBytes;
+	size_t rasterBudget;  /* 0 = Z64FONT_RASTER_BUDGET */
+	struct z64font_slab *scratch; /* stb_truetype's, reset every glyph */
+	struct z64font_sdf *sdf;      /* indexed like zchar[] */
+	struct z64font_slab *sdfSlab; /* sdf[].field are carved from these */
+	struct z64font_stats *stats; /* optional; timing is skipped if 0 */
+	size_t memCurrent;    /* bytes the core currently holds for this font */
+	size_t memPeak;       /* most bytes ever held at once */
+	size_t memBudget;     /* allocations beyond this fail; 0 = unlimited */
+	char isOverBudget;    /* an allocation failed since convertBegin/load */
+	char isResolved; /* zchar[].glyph matches current font and chars */
+	char skipUnchanged; /* don't rewrite outputs already up to date */
+	char isFontShared;  /* ttfBin belongs to another z64font, see z64font_share */
+	void (*info)(void *udata, const char *fmt, ...);  /* optional */
+	void (*error)(void *udata, const char *fmt, ...); /* optional */
+	void *udata;         /* passed to info and error */
+	char lastError[256]; /* latest error message, with no trailing newline */
 };
 #define Z64FONT_DEFAULTS { \
   .fontSize = 16 \
-  , .zchar = wow_calloc_die(ZCHAR_MAX, sizeof(struct zchar)) \
-  , .info = wow_stderr \
-  , .error = wow_stderr \
+  , .info = z64font_stderr \
+  , .error = z64font_stderr \
 }
 
+/* a z64font holds everything one conversion needs, errors included,
+ * and nothing in the core is global, so different z64fonts may be used
+ * from different threads at once; a single z64font must only be used
+ * by one thread at a time
+ */
 int z64font_convert(struct z64font *g);
-void z64font_exportBinaries(struct z64font *g, char **ofn);
-void z64font_exportDecomp(struct z64font *g, char **ofn);
+int z64font_resolve(struct z64font *g);
+int z64font_convertBegin(struct z64font *g);
+int z64font_convertCodepoints(struct z64font *g, const char *str);
+int z64font_convertNext(struct z64font *g, int max);
+int z64font_rasterizeNext(struct z64font *g, int fontSize, int max);
+void z64font_flushRasters(struct z64font *g);
+int z64font_exportBinaries(struct z64font *g, char **ofn);
+int z64font_exportDecomp(struct z64font *g, char **ofn);
+int z64font_exportTargets(
+	struct z64font *g
+	, const struct z64font_target **target
+	, int targetNum
+	, const char *base
+);
 int z64font_loadFont(struct z64font *g, const char *fn);
+
+/* sets up 'dst' with src's settings, codepoints and loaded font, for
+ * converting on another thread without loading the font again; the
+ * font data is borrowed, so src must not reload or free it while dst
+ * is in use; returns non-zero on fail
+ */
+int z64font_share(struct z64font *dst, const struct z64font *src);
+
+/* reverses the bytes of 'num' 32-bit entries, e.g. to get a little
+ * endian copy of widthTableBe; dst may be src
+ */
+void z64font_bswap32(void *dst, const void *src, size_t num);
+
+/* frees everything 'g' holds, leaving its settings as they were */
+void z64font_free(struct z64font *g);
 int z64font_loadCodepoints(struct z64font *g, const char *fn);
 int z64font_loadDecompFileNames(struct z64font *g, const char *fn);
+int z64font_threadCount(void);
+double z64font_seconds(void);
+
+/* prints to stderr; the info and error callbacks Z64FONT_DEFAULTS uses */
+void z64font_stderr(void *udata, const char *fmt, ...);
+const char *z64font_stageName(enum z64font_stage stage);
+const char *z64font_quantizerName(enum z64font_quantizer quantizer);
+int z64font_writeStatsJson(const struct z64font_stats *stats, FILE *fp);
+int z64font_writeClipReport(struct z64font *g, FILE *fp);
 
 #endif
 
@@ -7,13 +7,14 @@
 
 const struct zchar *zchar_findCodepoint(
 	const struct zchar *array
+	, unsigned num
 	, utf8_int32_t codepoint
 )
 {
 	const struct zchar *z = array;
 	
 	/* find matching codepoint */
-	for (z = array; z->bitmap; ++z)
+	for (z = array; z < array + num; ++z)
 	{
 		if (z->codepoint == codepoint)
 			return z;
@@ -40,8 +41,6 @@ int zchar_parseCodepoints(
 	for (zchar = arr, next = 0, w = chars; *w; w = next)
 	{
 		utf8_int32_t codepoint;
-		char c[16];
-		int sz = utf8codepointcalcsize(w);
 		
 		/* skip newlines */
 		while (*w == 0x0d || *w == 0x0a)
@@ -53,10 +52,6 @@ int zchar_parseCodepoints(
 		if (zchar - arr >= arrMax)
 			return -1;
 		
-		/* isolate multibyte character to its own string */
-		memcpy(c, w, sz);
-		c[sz] = '\0';
-		fprintf(stdout, "'%s' (%d)\n", c, sz);
 		next = utf8codepoint(w, &codepoint);
 		
 		zchar->codepoint = codepoint;
@@ -7,12 +7,20 @@
 struct zchar
 {
 	utf8_int32_t codepoint;
+	int glyph; /* glyph index, resolved once per font/charset load */
+	int first; /* index of first zchar sharing this glyph */
 	void *bitmap; /* bitmap in i8 format */
 	float width;
+	short inkX0; /* ink bounds in cell pixels; may extend past the cell */
+	short inkY0;
+	short inkX1; /* exclusive; equal to inkX0 if there is no ink */
+	short inkY1;
+	int clipped; /* inked pixels that didn't land inside the cell */
 };
 
 const struct zchar *zchar_findCodepoint(
 	const struct zchar *array
+	, unsigned num
 	, utf8_int32_t codepoint
 );
 
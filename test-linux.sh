@@ -0,0 +1,10 @@
+mkdir -p bin/test
+
+gcc -o bin/test/z64font-cli `./common.sh` -lm || exit 1
+
+# every bundled font and codepoint file must convert to exactly the bytes
+# recorded in test/golden.txt; after an intended change to the output,
+# rerun the same command without -g, redirected to test/golden.txt
+bin/test/z64font-cli golden -g test/golden.txt -o bin/test \
+	-c codepoints/oot.txt -c codepoints/mm.txt \
+	test/fonts/Lato-Regular.ttf test/fonts/SourceCodePro-Regular.ttf